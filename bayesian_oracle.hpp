@@ -1,37 +1,41 @@
 #pragma once
 
-#include "data.hpp"
 #include "dseparation.hpp"
-#include "pearson_chisq.hpp"
+#include "independence_test.hpp"
 
+// Independence oracle that memoizes the query results. All the methods can be
+// called from multiple threads concurrently.
+template <int W>
 class BayesianOracle {
 public:
     struct TimeLimitExceeded {};
 
     // Does not check that dag is indeed a DAG
-    BayesianOracle(const Digraph& dag, double timeLimit)
+    BayesianOracle(const Digraph<W>& dag, double timeLimit)
         : graphical_(true),
           vertCount_(dag.vertCount()),
           dag_(dag),
-          data_(*(const Data*)nullptr),
+          closure_(new DagClosure<W>(dag)),
+          test_(nullptr),
           timeLimit_(timeLimit),
-          indTestCountSinceLastTimeCheck_(0),
-          queriesBySeparatorSize_(1)
+          timeLimitExceeded_(false),
+          shards_(new Shard[ShardCount]),
+          queryCounts_(new atomic<uint64_t>[vertCount_ + 1]())
     {}
 
-    BayesianOracle(const Data& data, double timeLimit)
+    // Answers the queries using a statistical independence test, which must
+    // outlive the oracle
+    BayesianOracle(IndependenceTest<W>& test, double timeLimit)
         : graphical_(false),
-          vertCount_(data.catCounts.size()),
-          dag_(*(const Digraph*)nullptr),
-          data_(data),
+          vertCount_(test.varCount()),
+          dag_(*(const Digraph<W>*)nullptr),
+          test_(&test),
           timeLimit_(timeLimit),
-          indTestCountSinceLastTimeCheck_(0),
-          queriesBySeparatorSize_(1)
+          timeLimitExceeded_(false),
+          shards_(new Shard[ShardCount]),
+          queryCounts_(new atomic<uint64_t>[vertCount_ + 1]())
     {
-        CHECK(!data.points.empty());
-        for(const vector<int>& point : data.points) {
-            CHECK((int)point.size() == vertCount_);
-        }
+        CHECK(vertCount_ <= Bitset<W>::BitCount);
     }
 
     BayesianOracle(const BayesianOracle&) = delete;
@@ -47,54 +51,118 @@ public:
         return vertCount_;
     }
 
+    // The ancestors and descendants of the vertices of the DAG of a
+    // graphical oracle
+    const DagClosure<W>& dagClosure() const {
+        CHECK(graphical_);
+        return *closure_;
+    }
+
     // Returns true if a is independent of b given X
-    bool indTest(int a, Bitset X, int b) {
-        CHECK(a >= 0 && a <= vertCount_);
-        CHECK(b >= 0 && b <= vertCount_);
-        CHECK(a != b);
-        CHECK(X.isSubsetOf(Bitset::range(vertCount_)));
-        CHECK(!X.contains(a));
-        CHECK(!X.contains(b));
+    bool indTest(int a, Bitset<W> X, int b) {
+        checkQuery_(a, X, b);
+        checkTimeLimit_();
 
-        if(a > b) {
-            swap(a, b);
+        atomic<uint8_t>* state;
+        bool inserted;
+        tie(state, inserted) = findOrInsert_(a, X, b);
+
+        uint8_t stateVal = state->load(memory_order_acquire);
+        if(stateVal != Pending) {
+            return stateVal == Independent;
         }
 
-        int sepSize = X.count();
-        if(sepSize > (int)queriesBySeparatorSize_.size() - 1) {
-            queriesBySeparatorSize_.resize(sepSize + 1);
+        // The test is run without holding the lock. If another thread is
+        // running the same query concurrently, we run it too instead of
+        // waiting, as both get the same result.
+        bool result;
+        if(graphical_) {
+            result = isDSeparated(dag_, *closure_, a, X, b);
+        } else {
+            result = test_->indTests(X, {{a, b}})[0];
         }
 
-        ++indTestCountSinceLastTimeCheck_;
-        if(indTestCountSinceLastTimeCheck_ >= (graphical_ ? 1000 : 10)) {
-            indTestCountSinceLastTimeCheck_ = 0;
-            if(clock_.elapsedTime() > timeLimit_) {
-                throw TimeLimitExceeded();
+        if(inserted) {
+            store_(state, X, result);
+        }
+        return result;
+    }
+
+    // Returns the set of vertices b in bs such that a is independent of b
+    // given X. Equivalent to calling indTest for every b in bs, but the tests
+    // that are not memoized are run together in one batch.
+    Bitset<W> indTests(int a, Bitset<W> X, Bitset<W> bs) {
+        // Checked before inserting any of the queries as pending
+        bs.iterate([&](int b) {
+            checkQuery_(a, X, b);
+            checkTimeLimit_();
+        });
+
+        Bitset<W> ret = Bitset<W>::empty();
+
+        vector<int> runBs;
+        vector<pair<atomic<uint8_t>*, bool>> runStates;
+        bs.iterate([&](int b) {
+            atomic<uint8_t>* state;
+            bool inserted;
+            tie(state, inserted) = findOrInsert_(a, X, b);
+
+            uint8_t stateVal = state->load(memory_order_acquire);
+            if(stateVal == Pending) {
+                runBs.push_back(b);
+                runStates.emplace_back(state, inserted);
+            } else if(stateVal == Independent) {
+                ret.add(b);
             }
+        });
+
+        if(runBs.empty()) {
+            return ret;
         }
 
-        unordered_map<Query, bool>::iterator iter;
-        bool inserted;
-        tie(iter, inserted) =
-            queriesBySeparatorSize_[sepSize].insert({{{a, b}, X}, false});
+        vector<bool> results(runBs.size());
+        if(graphical_) {
+            // One sweep finds all the vertices d-connected to a
+            Bitset<W> runSet = Bitset<W>::empty();
+            for(int b : runBs) {
+                runSet.add(b);
+            }
+            Bitset<W> connected = dConnectedVertices(dag_, *closure_, a, X, runSet);
+            for(int i = 0; i < (int)runBs.size(); ++i) {
+                results[i] = !connected.contains(runBs[i]);
+            }
+        } else {
+            vector<pair<int, int>> pairs;
+            for(int b : runBs) {
+                pairs.emplace_back(a, b);
+            }
+            results = test_->indTests(X, pairs);
+        }
 
-        if(inserted) {
-            if(graphical_) {
-                iter->second = isDSeparated(dag_, a, X, b);
-            } else {
-                iter->second = pearsonChiSquaredIndTest(data_, a, X, b);
+        for(int i = 0; i < (int)runBs.size(); ++i) {
+            if(runStates[i].second) {
+                store_(runStates[i].first, X, results[i]);
+            }
+            if(results[i]) {
+                ret.add(runBs[i]);
             }
         }
-        return iter->second;
+        return ret;
     }
 
     int maxQueriedSeparatorSize() const {
-        return (int)queriesBySeparatorSize_.size() - 1;
+        int ret = 0;
+        for(int i = 0; i <= vertCount_; ++i) {
+            if(queryCounts_[i].load(memory_order_relaxed)) {
+                ret = i;
+            }
+        }
+        return ret;
     }
     vector<uint64_t> queryCountBySeparatorSize() const {
         vector<uint64_t> ret;
-        for(const auto& queries : queriesBySeparatorSize_) {
-            ret.push_back(queries.size());
+        for(int i = 0; i <= maxQueriedSeparatorSize(); ++i) {
+            ret.push_back(queryCounts_[i].load(memory_order_relaxed));
         }
         return ret;
     }
@@ -106,13 +174,90 @@ private:
     bool graphical_;
     int vertCount_;
 
-    const Digraph& dag_;
-    const Data& data_;
+    const Digraph<W>& dag_;
+    unique_ptr<const DagClosure<W>> closure_;
+    IndependenceTest<W>* test_;
 
     Clock clock_;
     double timeLimit_;
-    int indTestCountSinceLastTimeCheck_;
+    atomic<bool> timeLimitExceeded_;
+
+    typedef pair<pair<int, int>, Bitset<W>> Query;
 
-    typedef pair<pair<int, int>, Bitset> Query;
-    vector<unordered_map<Query, bool>> queriesBySeparatorSize_;
+    // Result states of the queries in the memo; the references to the
+    // elements of unordered_map stay valid when other elements are inserted,
+    // so the result can be stored without relocking.
+    enum : uint8_t {
+        Pending = 0,
+        Dependent = 1,
+        Independent = 2
+    };
+
+    // The query results are split to shards by the hash of the query, each
+    // protected by its own lock
+    static constexpr int ShardBits = 6;
+    static constexpr int ShardCount = 1 << ShardBits;
+    struct Shard {
+        SpinLock queriesLock;
+        unordered_map<Query, atomic<uint8_t>> queries;
+    };
+    unique_ptr<Shard[]> shards_;
+
+    // queryCounts_[i] is the number of distinct queries with separator size i
+    unique_ptr<atomic<uint64_t>[]> queryCounts_;
+
+    static int shardIdx_(const Query& query) {
+        uint64_t h = hash<Query>()(query);
+        return (int)((h * (uint64_t)0x9e3779b97f4a7c15) >> (64 - ShardBits));
+    }
+
+    void checkQuery_(int a, Bitset<W> X, int b) const {
+        CHECK(a >= 0 && a <= vertCount_);
+        CHECK(b >= 0 && b <= vertCount_);
+        CHECK(a != b);
+        CHECK(X.isSubsetOf(Bitset<W>::range(vertCount_)));
+        CHECK(!X.contains(a));
+        CHECK(!X.contains(b));
+    }
+
+    // Returns the result state of query (a, X, b) in the memo, inserting it
+    // as pending if it is not there, and whether it was inserted
+    pair<atomic<uint8_t>*, bool> findOrInsert_(int a, Bitset<W> X, int b) {
+        if(a > b) {
+            swap(a, b);
+        }
+        Query query = {{a, b}, X};
+        Shard& shard = shards_[shardIdx_(query)];
+        lock_guard<SpinLock> lock(shard.queriesLock);
+        auto iter = shard.queries.emplace(
+            piecewise_construct,
+            forward_as_tuple(query),
+            forward_as_tuple(Pending)
+        );
+        return {&iter.first->second, iter.second};
+    }
+
+    // Stores the result for a query inserted by findOrInsert_
+    void store_(atomic<uint8_t>* state, Bitset<W> X, bool result) {
+        state->store(result ? Independent : Dependent, memory_order_release);
+        queryCounts_[X.count()].fetch_add(1, memory_order_relaxed);
+    }
+
+    // Once the time limit has been exceeded in one thread, all the threads
+    // throw TimeLimitExceeded on their next query
+    void checkTimeLimit_() {
+        if(timeLimitExceeded_.load(memory_order_relaxed)) {
+            throw TimeLimitExceeded();
+        }
+        // Counted per thread to avoid contention
+        static thread_local int indTestCountSinceLastTimeCheck = 0;
+        ++indTestCountSinceLastTimeCheck;
+        if(indTestCountSinceLastTimeCheck >= (graphical_ ? 1000 : 10)) {
+            indTestCountSinceLastTimeCheck = 0;
+            if(clock_.elapsedTime() > timeLimit_) {
+                timeLimitExceeded_.store(true, memory_order_relaxed);
+                throw TimeLimitExceeded();
+            }
+        }
+    }
 };
@@ -1,158 +1,349 @@
 #pragma once
 
 #include "bayesian_oracle.hpp"
+#include "concurrent_map.hpp"
 #include "cpdag.hpp"
 #include "digraph.hpp"
+#include "thread_pool.hpp"
 #include "tree_decomposition.hpp"
 
+namespace bayesian_solve_ {
+
+// Subproblems with fewer robbers than this are solved serially even when
+// a thread pool is given, as spawning tasks for them costs more than it saves
+const int ParallelMinRobberCount = 8;
+
+// The chain of task groups that a branch of the search runs in. The branch
+// is abandoned when any of them is cancelled.
+struct CancelToken {
+    const TaskGroup* group;
+    const CancelToken* parent;
+};
+
+inline bool isCancelled(const CancelToken* token) {
+    for(; token != nullptr; token = token->parent) {
+        if(token->group->cancelled()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+}
+
+// Solves the cops and robbers game on the Bayesian network to decide whether
+// it has a tree decomposition of width at most tw, and constructs one if it
+// does. The solver is incremental: the components of the robbers do not
+// depend on tw and are memoized for the whole lifetime of the solver, and
+// the results of preSolve_ are memoized as bounds on tw, as a result true for
+// tw stays true for larger bounds and a result false for tw stays false for
+// smaller bounds. Thus when tw is increased, only the negative results are
+// evaluated again.
+//
+// If a thread pool is given, the alternative moves of the cops in solve_ and
+// the components of the robbers in preSolveImpl_ are explored as concurrent
+// tasks, and the siblings of a task that decides the result are cancelled. A
+// cancelled branch may return false without that being the actual result, so
+// its results are not memoized. The constructed tree decomposition always
+// uses the first winning move in vertex order, so it is the same as without
+// the thread pool. Different bounds may be solved concurrently.
+//
+// If a memory budget is given, the memo tables evict entries to stay within
+// it. Evicted results are computed again when needed, so the results do not
+// depend on the budget.
+template <int W>
 class BayesianNetworkTreeDecompositionSolver {
 public:
     BayesianNetworkTreeDecompositionSolver(
-        BayesianOracle& oracle,
-        Bitset verts,
-        int tw
+        BayesianOracle<W>& oracle,
+        Bitset<W> verts,
+        ThreadPool* pool = nullptr,
+        MemoBudget* memoBudget = nullptr
     )
         : oracle_(oracle),
           verts_(verts),
-          tw_(tw)
-    {
-        result_ = run_();
-    }
-    
-    bool result() {
-        return result_;
-    }
-
-    TreeDecomposition takeTreeDecomposition() {
-        TreeDecomposition ret;
-        swap(ret, treeDecomposition_);
-        return ret;
-    }
-
-private:
-    BayesianOracle& oracle_;
-    Bitset verts_;
-    int tw_;
-    bool result_;
-    unordered_map<pair<Bitset, Bitset>, bool> preSolveMem_;
-    unordered_map<pair<Bitset, int>, Bitset> extractComponentMem_;
-    TreeDecomposition treeDecomposition_;
-
-    bool run_() {
-        CHECK(tw_ >= 1);
+          pool_(pool),
+          preSolveMem_(memoBudget),
+          extractComponentMem_(memoBudget)
+    {}
+
+    BayesianNetworkTreeDecompositionSolver(const BayesianNetworkTreeDecompositionSolver&) = delete;
+    BayesianNetworkTreeDecompositionSolver(BayesianNetworkTreeDecompositionSolver&&) = delete;
+    BayesianNetworkTreeDecompositionSolver& operator=(const BayesianNetworkTreeDecompositionSolver&) = delete;
+    BayesianNetworkTreeDecompositionSolver& operator=(BayesianNetworkTreeDecompositionSolver&&) = delete;
+
+    // Returns true if there is a tree decomposition of width at most tw. The
+    // search may be cancelled through cancelToken, in which case the result
+    // is false.
+    bool solve(int tw, const bayesian_solve_::CancelToken* cancelToken = nullptr) {
+        CHECK(tw >= 1);
         if(verts_.count() <= 1) {
-            treeDecomposition_.emplace_back();
-            treeDecomposition_.back().verts = verts_;
-            treeDecomposition_.back().child1 = -1;
-            treeDecomposition_.back().child2 = -1;
             return true;
         }
-
         int initialCop = verts_.min();
-        if(!preSolve_(Bitset::singleton(initialCop), verts_.without(initialCop))) {
-            return false;
+        return preSolve_(Bitset<W>::singleton(initialCop), verts_.without(initialCop), tw, cancelToken);
+    }
+
+    // Returns a tree decomposition of width at most tw; solve(tw) must have
+    // returned true
+    TreeDecomposition<W> construct(int tw) {
+        TreeDecomposition<W> treeDecomposition;
+        if(verts_.count() <= 1) {
+            treeDecomposition.emplace_back();
+            treeDecomposition.back().verts = verts_;
+            treeDecomposition.back().child1 = -1;
+            treeDecomposition.back().child2 = -1;
+            return treeDecomposition;
         }
 
-        int root = preSolveConstruct_(Bitset::singleton(initialCop), verts_.without(initialCop));
+        int initialCop = verts_.min();
+        int root = preSolveConstruct_(
+            Bitset<W>::singleton(initialCop),
+            verts_.without(initialCop),
+            tw,
+            treeDecomposition
+        );
         CHECK(root == 0);
+        return treeDecomposition;
+    }
 
-        return true;
+    // The number of memoized results and their memory usage in bytes
+    size_t memoSize() const {
+        return preSolveMem_.size() + extractComponentMem_.size();
+    }
+    size_t memoMemoryUsage() const {
+        return preSolveMem_.memoryUsage() + extractComponentMem_.memoryUsage();
+    }
+
+private:
+    typedef bayesian_solve_::CancelToken CancelToken;
+
+    // preSolve_ is known to return true for bounds at least minTrueTW and
+    // false for bounds at most maxFalseTW
+    struct PreSolveBounds {
+        int maxFalseTW;
+        int minTrueTW;
+    };
+
+    BayesianOracle<W>& oracle_;
+    Bitset<W> verts_;
+    ThreadPool* pool_;
+    ConcurrentMap<pair<Bitset<W>, Bitset<W>>, PreSolveBounds> preSolveMem_;
+    ConcurrentMap<pair<Bitset<W>, int>, Bitset<W>> extractComponentMem_;
+
+    bool useTasks_(Bitset<W> robbers) const {
+        return pool_ != nullptr && robbers.count() >= bayesian_solve_::ParallelMinRobberCount;
+    }
+
+    // Returns the separator of newRobbers in cops
+    Bitset<W> separator_(Bitset<W> cops, Bitset<W> newRobbers) {
+        Bitset<W> newCops = cops;
+        cops.iterate([&](int c) {
+            if(newRobbers.iterateWhile([&](int r) {
+                return oracle_.indTest(c, newCops.without(c), r);
+            })) {
+                newCops.del(c);
+            }
+        });
+        return newCops;
     }
 
-    bool preSolveImpl_(Bitset cops, Bitset robbers) {
+    bool preSolveImpl_(Bitset<W> cops, Bitset<W> robbers, int tw, const CancelToken* token) {
         if(robbers.isEmpty()) {
             return true;
         }
+        if(useTasks_(robbers)) {
+            return preSolveTasks_(cops, robbers, tw, token);
+        }
 
-        Bitset newRobbers = extractComponent_(cops, robbers.min());
+        Bitset<W> newRobbers = extractComponent_(cops, robbers.min());
 
         if(!oracle_.graphical()) {
             newRobbers = newRobbers.intersectWith(robbers);
         }
 
-        Bitset newCops = cops;
-        cops.iterate([&](int c) {
-            if(newRobbers.iterateWhile([&](int r) {
-                return oracle_.indTest(c, newCops.without(c), r);
-            })) {
-                newCops.del(c);
-            }
-        });
+        Bitset<W> newCops = separator_(cops, newRobbers);
 
-        if(newCops.count() == tw_ + 1) {
+        if(newCops.count() == tw + 1) {
             return false;
         }
 
-        if(!solve_(newCops, newRobbers)) {
+        if(!solve_(newCops, newRobbers, tw, token)) {
             return false;
         }
 
-        return preSolve_(cops, robbers.minus(newRobbers));
+        return preSolve_(cops, robbers.minus(newRobbers), tw, token);
     }
-    bool preSolve_(Bitset cops, Bitset robbers) {
-        std::unordered_map<pair<Bitset, Bitset>, bool>::iterator iter;
-        bool inserted;
-        tie(iter, inserted) = preSolveMem_.emplace(make_pair(cops, robbers), false);
-        if(inserted) {
-            iter->second = preSolveImpl_(cops, robbers);
-        }
-        return iter->second;
+
+    // Same as preSolveImpl_, but splits all the robbers to components first
+    // and solves the components concurrently
+    bool preSolveTasks_(Bitset<W> cops, Bitset<W> robbers, int tw, const CancelToken* token) {
+        vector<pair<Bitset<W>, Bitset<W>>> subproblems;
+        vector<Bitset<W>> rest;
+        Bitset<W> left = robbers;
+        while(!left.isEmpty()) {
+            Bitset<W> newRobbers = extractComponent_(cops, left.min());
+
+            if(!oracle_.graphical()) {
+                newRobbers = newRobbers.intersectWith(left);
+            }
+
+            Bitset<W> newCops = separator_(cops, newRobbers);
+
+            if(newCops.count() == tw + 1) {
+                return false;
+            }
+
+            subproblems.emplace_back(newCops, newRobbers);
+            left = left.minus(newRobbers);
+            rest.push_back(left);
+        }
+
+        if(subproblems.size() == 1) {
+            return solve_(subproblems[0].first, subproblems[0].second, tw, token);
+        }
+
+        atomic<bool> failed(false);
+        {
+            TaskGroup group(*pool_);
+            CancelToken groupToken = {&group, token};
+            // Spawned in reverse order, as the own tasks of a thread are run
+            // in LIFO order, and the ones spawned first are stolen first
+            for(int i = (int)subproblems.size() - 1; i >= 0; --i) {
+                pair<Bitset<W>, Bitset<W>> subproblem = subproblems[i];
+                group.run([&, subproblem]() {
+                    if(!solve_(subproblem.first, subproblem.second, tw, &groupToken)) {
+                        failed.store(true);
+                        group.cancel();
+                    }
+                });
+            }
+            group.wait();
+        }
+        if(failed.load()) {
+            return false;
+        }
+
+        // The serial search would have found the remaining robbers after
+        // each component solvable as well
+        for(Bitset<W> suffix : rest) {
+            memoizePreSolve_(cops, suffix, tw, true);
+        }
+        return true;
+    }
+
+    bool preSolve_(Bitset<W> cops, Bitset<W> robbers, int tw, const CancelToken* token) {
+        PreSolveBounds bounds;
+        if(preSolveMem_.find(make_pair(cops, robbers), bounds)) {
+            if(tw >= bounds.minTrueTW) {
+                return true;
+            }
+            if(tw <= bounds.maxFalseTW) {
+                return false;
+            }
+        }
+        if(bayesian_solve_::isCancelled(token)) {
+            return false;
+        }
+        bool result = preSolveImpl_(cops, robbers, tw, token);
+        if(result || !bayesian_solve_::isCancelled(token)) {
+            memoizePreSolve_(cops, robbers, tw, result);
+        }
+        return result;
+    }
+    void memoizePreSolve_(Bitset<W> cops, Bitset<W> robbers, int tw, bool result) {
+        PreSolveBounds bounds;
+        bounds.maxFalseTW = result ? 0 : tw;
+        bounds.minTrueTW = result ? tw : INT32_MAX;
+        preSolveMem_.insertOrUpdate(
+            make_pair(cops, robbers),
+            bounds,
+            [&](PreSolveBounds& old) {
+                old.maxFalseTW = max(old.maxFalseTW, bounds.maxFalseTW);
+                old.minTrueTW = min(old.minTrueTW, bounds.minTrueTW);
+            }
+        );
     }
-    int preSolveConstruct_(Bitset cops, Bitset robbers) {
-        int nodeIdx = treeDecomposition_.size();
-        treeDecomposition_.emplace_back();
-        treeDecomposition_[nodeIdx].verts = cops;
-        treeDecomposition_[nodeIdx].child1 = -1;
-        treeDecomposition_[nodeIdx].child2 = -1;
+    int preSolveConstruct_(
+        Bitset<W> cops,
+        Bitset<W> robbers,
+        int tw,
+        TreeDecomposition<W>& treeDecomposition
+    ) {
+        int nodeIdx = treeDecomposition.size();
+        treeDecomposition.emplace_back();
+        treeDecomposition[nodeIdx].verts = cops;
+        treeDecomposition[nodeIdx].child1 = -1;
+        treeDecomposition[nodeIdx].child2 = -1;
 
         if(robbers.isEmpty()) {
             return nodeIdx;
         }
 
-        auto iter = extractComponentMem_.find(make_pair(cops, robbers.min()));
-        CHECK(iter != extractComponentMem_.end());
-        Bitset newRobbers = iter->second;
+        Bitset<W> newRobbers = extractComponent_(cops, robbers.min());
 
         if(!oracle_.graphical()) {
             newRobbers = newRobbers.intersectWith(robbers);
         }
 
-        Bitset newCops = cops;
-        cops.iterate([&](int c) {
-            if(newRobbers.iterateWhile([&](int r) {
-                return oracle_.indTest(c, newCops.without(c), r);
-            })) {
-                newCops.del(c);
-            }
-        });
+        Bitset<W> newCops = separator_(cops, newRobbers);
 
-        CHECK(newCops.count() <= tw_);
+        CHECK(newCops.count() <= tw);
 
-        int child = solveConstruct_(newCops, newRobbers);
-        treeDecomposition_[nodeIdx].child1 = child;
+        int child = solveConstruct_(newCops, newRobbers, tw, treeDecomposition);
+        treeDecomposition[nodeIdx].child1 = child;
         if(newRobbers != robbers) {
             CHECK(newRobbers.isSubsetOf(robbers));
-            child = preSolveConstruct_(cops, robbers.minus(newRobbers));
-            treeDecomposition_[nodeIdx].child2 = child;
+            child = preSolveConstruct_(cops, robbers.minus(newRobbers), tw, treeDecomposition);
+            treeDecomposition[nodeIdx].child2 = child;
         }
         return nodeIdx;
     }
 
-    bool solve_(Bitset cops, Bitset robbers) {
-        return !robbers.iterateWhile([&](int a) {
-            if(preSolve_(cops.with(a), robbers.without(a))) {
+    bool solve_(Bitset<W> cops, Bitset<W> robbers, int tw, const CancelToken* token) {
+        if(useTasks_(robbers)) {
+            atomic<bool> found(false);
+            TaskGroup group(*pool_);
+            CancelToken groupToken = {&group, token};
+            vector<int> moves;
+            robbers.iterate([&](int a) {
+                moves.push_back(a);
+            });
+            for(int i = (int)moves.size() - 1; i >= 0; --i) {
+                int a = moves[i];
+                group.run([&, a]() {
+                    if(preSolve_(cops.with(a), robbers.without(a), tw, &groupToken)) {
+                        found.store(true);
+                        group.cancel();
+                    }
+                });
+            }
+            group.wait();
+            return found.load();
+        }
+
+        bool ret = false;
+        robbers.iterateWhile([&](int a) {
+            if(bayesian_solve_::isCancelled(token)) {
                 return false;
             }
-            return true;
+            ret = preSolve_(cops.with(a), robbers.without(a), tw, token);
+            return !ret;
         });
+        return ret;
     }
-    int solveConstruct_(Bitset cops, Bitset robbers) {
+    int solveConstruct_(
+        Bitset<W> cops,
+        Bitset<W> robbers,
+        int tw,
+        TreeDecomposition<W>& treeDecomposition
+    ) {
+        // The results of the moves before the winning one found by the
+        // concurrent search may be missing, in which case they are solved now
         int ret = -1;
         CHECK(!robbers.iterateWhile([&](int a) {
-            auto iter = preSolveMem_.find(make_pair(cops.with(a), robbers.without(a)));
-            CHECK(iter != preSolveMem_.end());
-            if(iter->second) {
-                ret = preSolveConstruct_(cops.with(a), robbers.without(a));
+            if(preSolve_(cops.with(a), robbers.without(a), tw, nullptr)) {
+                ret = preSolveConstruct_(cops.with(a), robbers.without(a), tw, treeDecomposition);
                 return false;
             }
             return true;
@@ -161,70 +352,124 @@ private:
         return ret;
     }
 
-    Bitset extractComponentImpl_(Bitset cops, int r0) {
-        Bitset robbers = Bitset::singleton(r0);
-        Bitset robberQueue = Bitset::singleton(r0);
+    Bitset<W> extractComponentImpl_(Bitset<W> cops, int r0) {
+        Bitset<W> robbers = Bitset<W>::singleton(r0);
+        Bitset<W> robberQueue = Bitset<W>::singleton(r0);
         while(!robberQueue.isEmpty()) {
             int r1 = robberQueue.min();
             robberQueue.del(r1);
-            verts_.minus(cops.unionWith(robbers)).iterate([&](int r) {
-                if(!oracle_.indTest(r, cops, r1)) {
-                    robbers.add(r);
-                    robberQueue.add(r);
-                }
-            });
+            Bitset<W> candidates = verts_.minus(cops.unionWith(robbers));
+            Bitset<W> dependent = candidates.minus(oracle_.indTests(r1, cops, candidates));
+            robbers = robbers.unionWith(dependent);
+            robberQueue = robberQueue.unionWith(dependent);
         }
         return robbers;
     }
-    Bitset extractComponent_(Bitset cops, int r0) {
-        std::unordered_map<pair<Bitset, int>, Bitset>::iterator iter;
-        bool inserted;
-        tie(iter, inserted) = extractComponentMem_.emplace(make_pair(cops, r0), Bitset::empty());
-        if(inserted) {
-            iter->second = extractComponentImpl_(cops, r0);
-        }
-        return iter->second;
+    Bitset<W> extractComponent_(Bitset<W> cops, int r0) {
+        pair<Bitset<W>, int> key = make_pair(cops, r0);
+        Bitset<W> ret;
+        if(!extractComponentMem_.find(key, ret)) {
+            ret = extractComponentImpl_(cops, r0);
+            extractComponentMem_.insert(key, ret);
+        }
+        return ret;
     }
 };
 
-// Returns (tree decomposition, treewidth)
-inline pair<TreeDecomposition, int> reconstructConnectedBayesianNetworkTreeDecomposition(
-    BayesianOracle& oracle,
-    Bitset verts
+// Returns (tree decomposition, treewidth). If pool is given and
+// concurrentTWCount > 1, the treewidth bounds are tried concurrently in
+// groups of concurrentTWCount consecutive values with the same solver, and
+// the searches for bounds larger than a successful one are cancelled. The
+// memo tables of the solver are limited by memoBudget if it is given.
+template <int W>
+pair<TreeDecomposition<W>, int> reconstructConnectedBayesianNetworkTreeDecomposition(
+    BayesianOracle<W>& oracle,
+    Bitset<W> verts,
+    ThreadPool* pool = nullptr,
+    int concurrentTWCount = 1,
+    MemoBudget* memoBudget = nullptr
 ) {
     CHECK(!verts.isEmpty());
+    CHECK(concurrentTWCount >= 1);
     if(verts.count() == 1) {
-        TreeDecomposition treeDecomposition;
+        TreeDecomposition<W> treeDecomposition;
         treeDecomposition.emplace_back();
-        treeDecomposition[0].verts = Bitset::singleton(verts.min());
+        treeDecomposition[0].verts = Bitset<W>::singleton(verts.min());
         treeDecomposition[0].child1 = -1;
         treeDecomposition[0].child2 = -1;
         return {move(treeDecomposition), 0};
     }
 
-    int tw = 1;
+    BayesianNetworkTreeDecompositionSolver<W> solver(oracle, verts, pool, memoBudget);
+
+    if(pool == nullptr || concurrentTWCount == 1) {
+        int tw = 1;
+        while(!solver.solve(tw)) {
+            ++tw;
+        }
+        return {solver.construct(tw), tw};
+    }
+
+    // The search for each bound runs as the only task of its own group, so
+    // that it can be cancelled separately
+    struct Candidate {
+        Candidate(ThreadPool& pool) : group(pool), result(false) {}
+
+        TaskGroup group;
+        bool result;
+    };
+
+    int minTW = 1;
     while(true) {
-        BayesianNetworkTreeDecompositionSolver solver(oracle, verts, tw);
-        if(solver.result()) {
-            return {solver.takeTreeDecomposition(), tw};
+        vector<unique_ptr<Candidate>> candidates;
+        for(int i = 0; i < concurrentTWCount; ++i) {
+            candidates.emplace_back(new Candidate(*pool));
+        }
+
+        // Spawned in reverse order so that the smallest bound is run first
+        // by this thread
+        for(int i = concurrentTWCount - 1; i >= 0; --i) {
+            candidates[i]->group.run([&, i]() {
+                Candidate& candidate = *candidates[i];
+                bayesian_solve_::CancelToken token = {&candidate.group, nullptr};
+                if(solver.solve(minTW + i, &token)) {
+                    candidate.result = true;
+                    for(int j = i + 1; j < concurrentTWCount; ++j) {
+                        candidates[j]->group.cancel();
+                    }
+                }
+            });
+        }
+
+        for(int i = 0; i < concurrentTWCount; ++i) {
+            candidates[i]->group.wait();
+        }
+        for(int i = 0; i < concurrentTWCount; ++i) {
+            if(candidates[i]->result) {
+                return {solver.construct(minTW + i), minTW + i};
+            }
         }
-        ++tw;
+        minTW += concurrentTWCount;
     }
 }
 
 // Returns (tree decompositions, treewidth)
-inline pair<vector<TreeDecomposition>, int> reconstructBayesianNetworkTreeDecomposition(
-    BayesianOracle& oracle
+template <int W>
+pair<vector<TreeDecomposition<W>>, int> reconstructBayesianNetworkTreeDecomposition(
+    BayesianOracle<W>& oracle,
+    ThreadPool* pool = nullptr,
+    int concurrentTWCount = 1,
+    MemoBudget* memoBudget = nullptr
 ) {
     int vertCount = oracle.vertCount();
 
-    vector<Bitset> comps;
+    vector<Bitset<W>> comps;
     for(int v = 0; v < vertCount; ++v) {
         int found = -1;
         int compIdx = 0;
         while(compIdx < (int)comps.size()) {
             if(!comps[compIdx].iterateWhile([&](int x) {
-                return oracle.indTest(v, Bitset::empty(), x);
+                return oracle.indTest(v, Bitset<W>::empty(), x);
             })) {
                 if(found == -1) {
                     comps[compIdx].add(v);
@@ -240,17 +485,19 @@ inline pair<vector<TreeDecomposition>, int> reconstructBayesianNetworkTreeDecomp
             }
         }
         if(found == -1) {
-            comps.push_back(Bitset::singleton(v));
+            comps.push_back(Bitset<W>::singleton(v));
         }
     }
 
-    vector<TreeDecomposition> treeDecompositions;
+    vector<TreeDecomposition<W>> treeDecompositions;
 
     int tw = 0;
-    for(Bitset comp : comps) {
+    for(Bitset<W> comp : comps) {
         int compTW;
-        TreeDecomposition treeDecomposition;
-        tie(treeDecomposition, compTW) = reconstructConnectedBayesianNetworkTreeDecomposition(oracle, comp);
+        TreeDecomposition<W> treeDecomposition;
+        tie(treeDecomposition, compTW) = reconstructConnectedBayesianNetworkTreeDecomposition(
+            oracle, comp, pool, concurrentTWCount, memoBudget
+        );
         tw = max(tw, compTW);
         treeDecompositions.push_back(move(treeDecomposition));
     }
@@ -259,21 +506,27 @@ inline pair<vector<TreeDecomposition>, int> reconstructBayesianNetworkTreeDecomp
 }
 
 // Returns (skeleton, removed edge separators, tree decompositions, treewidth)
-inline tuple<
-    Graph,
-    vector<pair<pair<int, int>, Bitset>>,
-    vector<TreeDecomposition>,
+template <int W>
+tuple<
+    Graph<W>,
+    vector<pair<pair<int, int>, Bitset<W>>>,
+    vector<TreeDecomposition<W>>,
     int
 > reconstructBayesianNetworkSkeleton(
-    BayesianOracle& oracle
+    BayesianOracle<W>& oracle,
+    ThreadPool* pool = nullptr,
+    int concurrentTWCount = 1,
+    MemoBudget* memoBudget = nullptr
 ) {
-    vector<TreeDecomposition> treeDecompositions;
+    vector<TreeDecomposition<W>> treeDecompositions;
     int tw;
-    tie(treeDecompositions, tw) = reconstructBayesianNetworkTreeDecomposition(oracle);
+    tie(treeDecompositions, tw) = reconstructBayesianNetworkTreeDecomposition(
+        oracle, pool, concurrentTWCount, memoBudget
+    );
 
-    vector<Bitset> bags;
-    for(const TreeDecomposition& treeDecomposition : treeDecompositions) {
-        for(const TreeDecompositionNode& node : treeDecomposition) {
+    vector<Bitset<W>> bags;
+    for(const TreeDecomposition<W>& treeDecomposition : treeDecompositions) {
+        for(const TreeDecompositionNode<W>& node : treeDecomposition) {
             bags.push_back(node.verts);
         }
     }
@@ -294,27 +547,27 @@ inline tuple<
         }
     }
 
-    Graph skeleton(oracle.vertCount());
-    for(Bitset bag : bags) {
+    Graph<W> skeleton(oracle.vertCount());
+    for(Bitset<W> bag : bags) {
         bag.iterate([&](int b) {
-            bag.intersectWith(Bitset::range(b)).minus(skeleton.adjacentVerts(b)).iterate([&](int a) {
+            bag.intersectWith(Bitset<W>::range(b)).minus(skeleton.adjacentVerts(b)).iterate([&](int a) {
                 skeleton.addEdge(a, b);
             });
         });
     }
 
-    vector<pair<pair<int, int>, Bitset>> edgeSeparators;
+    vector<pair<pair<int, int>, Bitset<W>>> edgeSeparators;
     for(int b = 0; b < oracle.vertCount(); ++b) {
-        skeleton.adjacentVerts(b).intersectWith(Bitset::range(b)).iterate([&](int a) {
-            for(Bitset bag : bags) {
+        skeleton.adjacentVerts(b).intersectWith(Bitset<W>::range(b)).iterate([&](int a) {
+            for(Bitset<W> bag : bags) {
                 if(!bag.contains(a) && !bag.contains(b)) {
                     continue;
                 }
-                Bitset supset = bag.without(a).without(b);
+                Bitset<W> supset = bag.without(a).without(b);
                 if(supset.isEmpty()) {
                     continue;
                 }
-                if(!supset.iterateSubsetsWhile([&](Bitset X) {
+                if(!supset.iterateSubsetsWhile([&](Bitset<W> X) {
                     if(oracle.indTest(a, X, b)) {
                         edgeSeparators.emplace_back(make_pair(a, b), X);
                         return false;
@@ -333,21 +586,30 @@ inline tuple<
     return {move(skeleton), move(edgeSeparators), move(treeDecompositions), tw};
 }
 
-// Returns (CPDAG, tree decompositions, treewidth)
-inline tuple<
-    Digraph,
-    vector<TreeDecomposition>,
+// Returns (CPDAG, tree decompositions, treewidth). If pool is given, the tree
+// decompositions are searched for using its threads, with the same result;
+// see reconstructConnectedBayesianNetworkTreeDecomposition for
+// concurrentTWCount and memoBudget.
+template <int W>
+tuple<
+    Digraph<W>,
+    vector<TreeDecomposition<W>>,
     int
 > reconstructBayesianNetwork(
-    BayesianOracle& oracle
+    BayesianOracle<W>& oracle,
+    ThreadPool* pool = nullptr,
+    int concurrentTWCount = 1,
+    MemoBudget* memoBudget = nullptr
 ) {
-    Graph skeleton;
-    vector<pair<pair<int, int>, Bitset>> edgeSeparators;
-    vector<TreeDecomposition> treeDecompositions;
+    Graph<W> skeleton;
+    vector<pair<pair<int, int>, Bitset<W>>> edgeSeparators;
+    vector<TreeDecomposition<W>> treeDecompositions;
     int tw;
-    tie(skeleton, edgeSeparators, treeDecompositions, tw) = reconstructBayesianNetworkSkeleton(oracle);
+    tie(skeleton, edgeSeparators, treeDecompositions, tw) = reconstructBayesianNetworkSkeleton(
+        oracle, pool, concurrentTWCount, memoBudget
+    );
 
-    Digraph cpdag = constructCPDAG(skeleton, edgeSeparators);
+    Digraph<W> cpdag = constructCPDAG(skeleton, edgeSeparators);
 
     return {move(cpdag), move(treeDecompositions), tw};
 }
@@ -1,6 +1,7 @@
 #include "bayesian_oracle.hpp"
 #include "bayesian_solve.hpp"
 #include "digraph.hpp"
+#include "dseparation.hpp"
 #include "graph.hpp"
 #include "tree_decomposition.hpp"
 #include "treewidth_solver.hpp"
@@ -36,15 +37,16 @@ void updateStats(int vertCount, int tw, double runTime) {
     }
 }
 
-Graph moralizeDAG(const Digraph& dag) {
-    Graph graph(dag.vertCount());
+template <int W>
+Graph<W> moralizeDAG(const Digraph<W>& dag) {
+    Graph<W> graph(dag.vertCount());
     for(int v = 0; v < dag.vertCount(); ++v) {
         dag.edgesIn(v).iterate([&](int x) {
             graph.addEdge(x, v);
         });
     }
     for(int v = 0; v < dag.vertCount(); ++v) {
-        Bitset parents = dag.edgesIn(v);
+        Bitset<W> parents = dag.edgesIn(v);
         parents.iterate([&](int x) {
             parents.without(x).minus(graph.adjacentVerts(x)).iterate([&](int y) {
                 graph.addEdge(x, y);
@@ -54,8 +56,9 @@ Graph moralizeDAG(const Digraph& dag) {
     return graph;
 }
 
-Graph constructSkeleton(const Digraph& digraph) {
-    Graph graph(digraph.vertCount());
+template <int W>
+Graph<W> constructSkeleton(const Digraph<W>& digraph) {
+    Graph<W> graph(digraph.vertCount());
     for(int v = 0; v < digraph.vertCount(); ++v) {
         digraph.neighbors(v).iterate([&](int x) {
             graph.addEdge(v, x);
@@ -64,14 +67,60 @@ Graph constructSkeleton(const Digraph& digraph) {
     return graph;
 }
 
+// Checks the closure of digraph against walking its edges
+template <int W>
+void checkDagClosure(const Digraph<W>& digraph, const DagClosure<W>& closure) {
+    for(int v = 0; v < digraph.vertCount(); ++v) {
+        Bitset<W> vs = Bitset<W>::singleton(v);
+        CHECK(closure.ancestorsWithSelf(v) == dseparation_::ancestorsWithSelf(digraph, vs));
+        CHECK(closure.descendantsWithSelf(v) == dseparation_::descendantsWithSelf(digraph, vs));
+    }
+}
+
+// Checks that the parallel variants of our algorithm give the same result as
+// the serial one: the search on the thread pool, concurrent treewidth bounds
+// and memo tables that evict entries on every growth. The variants that
+// exceed the time limit are skipped.
+template <int W>
+void checkParallelVariants(
+    const Digraph<W>& dag,
+    double timeLimit,
+    ThreadPool& pool,
+    const Digraph<W>& cpdag,
+    const vector<TreeDecomposition<W>>& treeDecompositions,
+    int tw
+) {
+    for(int concurrentTWCount : {1, 3}) {
+        for(bool evict : {false, true}) {
+            MemoBudget memoBudget(evict ? 1 : SIZE_MAX);
+            Digraph<W> parallelCPDAG;
+            vector<TreeDecomposition<W>> parallelTreeDecompositions;
+            int parallelTW;
+            BayesianOracle<W> oracle(dag, timeLimit);
+            try {
+                tie(parallelCPDAG, parallelTreeDecompositions, parallelTW) = reconstructBayesianNetwork(
+                    oracle, &pool, concurrentTWCount, &memoBudget
+                );
+            } catch(typename BayesianOracle<W>::TimeLimitExceeded) {
+                continue;
+            }
+            CHECK(parallelCPDAG == cpdag);
+            CHECK(parallelTreeDecompositions == treeDecompositions);
+            CHECK(parallelTW == tw);
+            CHECK(memoBudget.memoryUsage() == 0);
+        }
+    }
+}
+
 // Returns false if the time limit was exceeded
-bool runTest(const Digraph& dag, double timeLimit, TreewidthSolver& twSolver) {
+template <int W>
+bool runTest(const Digraph<W>& dag, double timeLimit, TreewidthSolver& twSolver, ThreadPool& pool) {
     ScopedFailureContextPrint scopedFailureContextPrint(
         [&](std::ostream& out) {
             out << "DAG:\n";
             out << dag.vertCount() << '\n';
             for(int v = 0; v < dag.vertCount(); ++v) {
-                Bitset edgesOut = dag.edgesOut(v);
+                Bitset<W> edgesOut = dag.edgesOut(v);
                 out << edgesOut.count();
                 edgesOut.iterate([&](int x) {
                     out << ' ' << x;
@@ -81,21 +130,22 @@ bool runTest(const Digraph& dag, double timeLimit, TreewidthSolver& twSolver) {
         }
     );
 
-    Digraph cpdag;
-    vector<TreeDecomposition> treeDecompositions;
+    Digraph<W> cpdag;
+    vector<TreeDecomposition<W>> treeDecompositions;
     int tw;
-    BayesianOracle oracle(dag, timeLimit);
+    BayesianOracle<W> oracle(dag, timeLimit);
+    checkDagClosure(dag, oracle.dagClosure());
     try {
         tie(cpdag, treeDecompositions, tw) = reconstructBayesianNetwork(oracle);
-    } catch(BayesianOracle::TimeLimitExceeded) {
+    } catch(typename BayesianOracle<W>::TimeLimitExceeded) {
         return false;
     }
     double runTime = oracle.elapsedTime();
 
     CHECK(oracle.maxQueriedSeparatorSize() <= tw + 1);
 
-    Graph skeleton = constructSkeleton(cpdag);
-    Graph correctSkeleton = constructSkeleton(dag);
+    Graph<W> skeleton = constructSkeleton(cpdag);
+    Graph<W> correctSkeleton = constructSkeleton(dag);
     CHECK(skeleton == correctSkeleton);
 
     for(int a = 0; a < dag.vertCount(); ++a) {
@@ -112,19 +162,22 @@ bool runTest(const Digraph& dag, double timeLimit, TreewidthSolver& twSolver) {
         });
     }
 
-    Graph moralGraph = moralizeDAG(dag);
+    Graph<W> moralGraph = moralizeDAG(dag);
     checkTreeDecompositions(treeDecompositions, moralGraph, tw);
 
     int correctTW = twSolver.solve(moralGraph);
     CHECK(tw == correctTW);
 
+    checkParallelVariants(dag, timeLimit, pool, cpdag, treeDecompositions, tw);
+
     updateStats(dag.vertCount(), tw, runTime);
 
     return true;
 }
 
-void runTests(int vertCount, double timeLimit, TreewidthSolver& twSolver) {
-    Digraph dag(vertCount);
+template <int W>
+void runTests(int vertCount, double timeLimit, TreewidthSolver& twSolver, ThreadPool& pool) {
+    Digraph<W> dag(vertCount);
 
     std::vector<std::pair<int, int>> unusedEdges;
     for(int a = 0; a < vertCount; ++a) {
@@ -134,7 +187,7 @@ void runTests(int vertCount, double timeLimit, TreewidthSolver& twSolver) {
     }
 
     while(true) {
-        if(!runTest(dag, timeLimit, twSolver)) {
+        if(!runTest(dag, timeLimit, twSolver, pool)) {
             break;
         }
 
@@ -163,11 +216,22 @@ int main(int argc, char* argv[]) {
 
     CHECK(minVertCount >= 0);
     CHECK(minVertCount <= maxVertCount);
-    CHECK(maxVertCount <= Graph::MaxVertCount);
+    CHECK(maxVertCount <= MaxVertCount);
     CHECK(isfinite(timeLimit) && timeLimit > 0.0);
 
+    // The closure also handles cycles
+    Digraph<1> cyclic(4);
+    cyclic.addEdge(0, 1);
+    cyclic.addEdge(1, 2);
+    cyclic.addEdge(2, 1);
+    cyclic.addEdge(2, 3);
+    checkDagClosure(cyclic, DagClosure<1>(cyclic));
+
     TreewidthSolver twSolver;
 
+    // Small pool for checking the parallel variants of our algorithm
+    ThreadPool pool(2);
+
     std::priority_queue<
         std::pair<double, int>,
         std::vector<std::pair<double, int>>,
@@ -183,7 +247,9 @@ int main(int argc, char* argv[]) {
         vertCountQueue.pop();
 
         Clock clock;
-        runTests(vertCount, timeLimit, twSolver);
+        dispatchBitsetWordCount(vertCount, [&](auto words) {
+            runTests<decltype(words)::value>(vertCount, timeLimit, twSolver, pool);
+        });
         totalTime += clock.elapsedTime();
 
         vertCountQueue.emplace(totalTime, vertCount);
@@ -0,0 +1,208 @@
+#pragma once
+
+#include "contingency.hpp"
+
+// Index of a data set consisting of a bitmap over the data points for each
+// category of each indexed variable. The bitmaps let the contingency tables of
+// low-arity variables be counted by popcounts of their intersections instead
+// of passes over the data.
+class BitmapIndex {
+public:
+    // Maximum number of mask operations per 64 data points for which the
+    // index is used to count contingency tables
+    static constexpr int MaxCountingCost = 256;
+
+    BitmapIndex() : pointCount_(0), wordCount_(0) {}
+
+    // Indexes the variables of data in the order of increasing category count
+    // until the next one would make the bitmaps take more than memoryBudget
+    // bytes
+    BitmapIndex(const Data& data, size_t memoryBudget)
+        : pointCount_(data.pointCount()),
+          wordCount_((data.pointCount() + 63) / 64),
+          catCounts_(data.catCounts()),
+          offsets_(data.varCount(), SIZE_MAX)
+    {
+        vector<int> vars(data.varCount());
+        for(int v = 0; v < data.varCount(); ++v) {
+            vars[v] = v;
+        }
+        stable_sort(vars.begin(), vars.end(), [&](int v1, int v2) {
+            return catCounts_[v1] < catCounts_[v2];
+        });
+
+        size_t wordTotal = 0;
+        for(int v : vars) {
+            size_t size = (size_t)catCounts_[v] * (size_t)wordCount_;
+            if((wordTotal + size) * sizeof(uint64_t) > memoryBudget) {
+                break;
+            }
+            offsets_[v] = wordTotal;
+            wordTotal += size;
+        }
+
+        bits_.assign(wordTotal, 0);
+        dispatchDataValueType(data, [&](auto t) {
+            typedef decltype(t) T;
+            vector<T> buffer(contingency_::CountingBlockSize);
+            for(int v = 0; v < data.varCount(); ++v) {
+                if(offsets_[v] == SIZE_MAX) {
+                    continue;
+                }
+                uint64_t* bits = bits_.data() + offsets_[v];
+                for(int start = 0; start < pointCount_; start += contingency_::CountingBlockSize) {
+                    int blockSize = min(contingency_::CountingBlockSize, pointCount_ - start);
+                    const T* values = data.values<T>(v, start, blockSize, buffer.data());
+                    for(int j = 0; j < blockSize; ++j) {
+                        int i = start + j;
+                        bits[(size_t)values[j] * wordCount_ + (i >> 6)] |= (uint64_t)1 << (i & 63);
+                    }
+                }
+            }
+        });
+    }
+
+    int pointCount() const {
+        return pointCount_;
+    }
+
+    // The number of 64-bit words in each bitmap
+    int wordCount() const {
+        return wordCount_;
+    }
+
+    bool indexed(int v) const {
+        return offsets_[v] != SIZE_MAX;
+    }
+
+    int indexedVarCount() const {
+        int ret = 0;
+        for(int v = 0; v < (int)offsets_.size(); ++v) {
+            if(indexed(v)) {
+                ++ret;
+            }
+        }
+        return ret;
+    }
+
+    // The size of the bitmaps in bytes
+    size_t memoryUsage() const {
+        return bits_.size() * sizeof(uint64_t);
+    }
+
+    // Bit i of the returned bitmap is set if data point i has category cat
+    // for variable v. The bits past pointCount() are zero. Requires
+    // indexed(v).
+    const uint64_t* bitmap(int v, int cat) const {
+        return bits_.data() + offsets_[v] + (size_t)cat * wordCount_;
+    }
+
+    // Returns true if the contingency tables of a and b in the strata of X
+    // should be counted using the index, that is, if all the variables are
+    // indexed and the tables are small enough.
+    template <int W>
+    bool coversQuery(Bitset<W> X, int a, int b) const {
+        if(!indexed(a) || !indexed(b)) {
+            return false;
+        }
+        int configCount = 1;
+        bool ok = true;
+        X.iterate([&](int v) {
+            if(!indexed(v)) {
+                ok = false;
+            }
+            configCount = min(configCount * catCounts_[v], MaxCountingCost + 1);
+        });
+        if(!ok) {
+            return false;
+        }
+        int cost = configCount * (catCounts_[b] * (catCounts_[a] + 1) + 1);
+        return cost <= MaxCountingCost;
+    }
+
+    // Counts the contingency tables of a and b in the strata of X, which are
+    // numbered in the same way as in the dense path of computeStrata. Requires
+    // coversQuery(X, a, b).
+    template <int W>
+    void countContingencyTables(
+        Bitset<W> X,
+        int a,
+        int b,
+        ContingencyTables& tables
+    ) const {
+        int aCatCount = catCounts_[a];
+        int bCatCount = catCounts_[b];
+
+        vector<pair<int, int>> XVars;
+        int configCount = 1;
+        X.iterate([&](int v) {
+            XVars.emplace_back(v, catCounts_[v]);
+            configCount *= catCounts_[v];
+        });
+
+        tables.aCatCount = aCatCount;
+        tables.bCatCount = bCatCount;
+        tables.stratumCount = configCount;
+        tables.sparse = false;
+        tables.counts.assign((size_t)configCount * aCatCount * bCatCount, 0);
+
+        // The words are processed in blocks to keep the working set small
+        const int BlockWordCount = 256;
+        vector<uint64_t> strata((size_t)configCount * BlockWordCount);
+        vector<uint64_t> mask(BlockWordCount);
+        for(int start = 0; start < wordCount_; start += BlockWordCount) {
+            int words = min(BlockWordCount, wordCount_ - start);
+
+            // Intersect the bitmaps of X in mixed-radix order: after
+            // processing variables with radix r, the bitmap k < r in strata
+            // is the bitmap of configuration k of those variables
+            fill(strata.begin(), strata.begin() + words, ~(uint64_t)0);
+            int radix = 1;
+            for(pair<int, int> var : XVars) {
+                for(int val = var.second - 1; val >= 0; --val) {
+                    const uint64_t* valBitmap = bitmap(var.first, val) + start;
+                    for(int k = 0; k < radix; ++k) {
+                        const uint64_t* src = strata.data() + (size_t)k * BlockWordCount;
+                        uint64_t* dest = strata.data() + (size_t)(val * radix + k) * BlockWordCount;
+                        for(int w = 0; w < words; ++w) {
+                            dest[w] = src[w] & valBitmap[w];
+                        }
+                    }
+                }
+                radix *= var.second;
+            }
+
+            uint32_t* counts = tables.counts.data();
+            for(int s = 0; s < configCount; ++s) {
+                const uint64_t* stratum = strata.data() + (size_t)s * BlockWordCount;
+                for(int bVal = 0; bVal < bCatCount; ++bVal) {
+                    const uint64_t* bBitmap = bitmap(b, bVal) + start;
+                    for(int w = 0; w < words; ++w) {
+                        mask[w] = stratum[w] & bBitmap[w];
+                    }
+                    for(int aVal = 0; aVal < aCatCount; ++aVal) {
+                        *counts++ += intersectionCount_(mask.data(), bitmap(a, aVal) + start, words);
+                    }
+                }
+            }
+        }
+    }
+
+private:
+    int pointCount_;
+    int wordCount_;
+    vector<int> catCounts_;
+
+    // The bitmaps of variable v start at bits_[offsets_[v]], or
+    // offsets_[v] == SIZE_MAX if v is not indexed
+    vector<size_t> offsets_;
+    vector<uint64_t> bits_;
+
+    static uint32_t intersectionCount_(const uint64_t* x, const uint64_t* y, int words) {
+        uint64_t ret = 0;
+        for(int w = 0; w < words; ++w) {
+            ret += (uint64_t)__builtin_popcountll(x[w] & y[w]);
+        }
+        return (uint32_t)ret;
+    }
+};
@@ -2,10 +2,13 @@
 
 #include "common.hpp"
 
-// No bounds checking
+// No bounds checking. W is the number of 64-bit words in the set.
+template <int W>
 class Bitset {
 public:
-    static constexpr int WordCount = 2;
+    static_assert(W >= 1, "Bitset needs at least one word");
+
+    static constexpr int WordCount = W;
     static constexpr int BitCount = 64 * WordCount;
 
     Bitset() {}
@@ -176,6 +179,11 @@ public:
         return minus(X).isEmpty();
     }
 
+    // The w-th 64-bit word of the set, containing the elements [64 w, 64 w + 64)
+    uint64_t word(int w) const {
+        return words_[w];
+    }
+
     bool operator==(Bitset other) const {
         for(int w = 0; w < WordCount; ++w) {
             if(words_[w] != other.words_[w]) {
@@ -199,8 +207,12 @@ private:
         return ret;
     }
     static Bitset subtract_(Bitset a, Bitset b) {
-        bool carry = true;
         Bitset ret;
+        if(W == 1) {
+            ret.words_[0] = a.words_[0] - b.words_[0];
+            return ret;
+        }
+        bool carry = true;
         for(int w = 0; w < WordCount; ++w) {
             if(carry) {
                 ret.words_[w] = a.words_[w] + ~b.words_[w] + (uint64_t)1;
@@ -235,6 +247,12 @@ private:
         return ret;
     }
     static Bitset shiftRight_(Bitset x, int d) {
+        if(W == 1) {
+            Bitset ret;
+            ret.words_[0] = d < 64 ? x.words_[0] >> d : 0;
+            return ret;
+        }
+
         auto read = [&](int i) -> uint64_t {
             if(i < WordCount) {
                 return x.words_[i];
@@ -259,6 +277,13 @@ private:
         return ret;
     }
     static Bitset pdep_(Bitset src, Bitset mask) {
+        if(W == 1) {
+            // Single word: no need to track the position in the source
+            Bitset ret;
+            ret.words_[0] = _pdep_u64(src.words_[0], mask.words_[0]);
+            return ret;
+        }
+
         uint64_t srcWord = src.words_[0];
         int readWordIdx = 1;
         int readBitIdx = 0;
@@ -302,14 +327,41 @@ private:
 };
 
 namespace std {
-    template <>
-    struct hash<Bitset> {
-        inline size_t operator()(const Bitset& val) const {
+    template <int W>
+    struct hash<Bitset<W>> {
+        inline size_t operator()(const Bitset<W>& val) const {
             size_t x = 0;
-            for(int w = 0; w < Bitset::WordCount; ++w) {
+            for(int w = 0; w < W; ++w) {
                 hashCombine(x, val.words_[w]);
             }
             return x;
         }
     };
 }
+
+// The largest vertex count supported by dispatchBitsetWordCount.
+constexpr int MaxVertCount = 64 * 32;
+
+// Calls f(integral_constant<int, W>()) with the smallest instantiated word
+// count W such that Bitset<W> can hold bitCount bits. Word counts are
+// instantiated in powers of two to keep the compilation time reasonable.
+template <typename F>
+auto dispatchBitsetWordCount(int bitCount, F f) -> decltype(f(integral_constant<int, 1>())) {
+    CHECK(bitCount >= 0 && bitCount <= MaxVertCount);
+    if(bitCount <= 64) {
+        return f(integral_constant<int, 1>());
+    }
+    if(bitCount <= 128) {
+        return f(integral_constant<int, 2>());
+    }
+    if(bitCount <= 256) {
+        return f(integral_constant<int, 4>());
+    }
+    if(bitCount <= 512) {
+        return f(integral_constant<int, 8>());
+    }
+    if(bitCount <= 1024) {
+        return f(integral_constant<int, 16>());
+    }
+    return f(integral_constant<int, 32>());
+}
@@ -0,0 +1,74 @@
+#include "bayesian_oracle.hpp"
+#include "bayesian_solve.hpp"
+#include "file.hpp"
+#include "pc_algorithm.hpp"
+
+// Returns the run time of the algorithm with the exact independence oracle,
+// or -1 if the time limit was exceeded
+template <int W, typename F>
+static double timeAlgorithm(
+    const Digraph<W>& dag,
+    const Digraph<W>& cpdag,
+    double timeLimit,
+    F algo
+) {
+    BayesianOracle<W> oracle(dag, timeLimit);
+    Digraph<W> learnedCPDAG;
+    try {
+        learnedCPDAG = algo(oracle);
+    } catch(typename BayesianOracle<W>::TimeLimitExceeded) {
+        return -1.0;
+    }
+    CHECK(learnedCPDAG == cpdag);
+    return oracle.elapsedTime();
+}
+
+template <int W>
+static pair<double, double> timeAlgorithms(string filename, double timeLimit) {
+    Digraph<W> dag, cpdag;
+    tie(dag, cpdag) = readBnRepositoryNet<W>(filename);
+
+    double ourTime = timeAlgorithm(dag, cpdag, timeLimit, [&](BayesianOracle<W>& oracle) {
+        return get<0>(reconstructBayesianNetwork(oracle));
+    });
+    double pcTime = timeAlgorithm(dag, cpdag, timeLimit, [&](BayesianOracle<W>& oracle) {
+        return pcAlgorithm(oracle);
+    });
+    return {ourTime, pcTime};
+}
+
+static void printComparison(const char* name, double oneWordTime, double twoWordTime) {
+    cout << "  " << name << ":\n";
+    if(oneWordTime < 0.0 || twoWordTime < 0.0) {
+        cout << "    TIMEOUT\n";
+        return;
+    }
+    cout << "    1 word:  " << oneWordTime << " s\n";
+    cout << "    2 words: " << twoWordTime << " s\n";
+    cout << "    Speedup: " << twoWordTime / oneWordTime << "x\n";
+}
+
+int main(int argc, char* argv[]) {
+    if(argc < 3) {
+        cerr << "Usage: ./bitset_benchmark <time limit> <filename>...\n";
+        CHECK(false);
+    }
+
+    double timeLimit = parseString<double>(argv[1]);
+    CHECK(isfinite(timeLimit) && timeLimit > 0.0);
+
+    for(int i = 2; i < argc; ++i) {
+        CHECK(readBnRepositoryNetVertCount(argv[i]) <= 64);
+
+        double ourOneWordTime, pcOneWordTime;
+        tie(ourOneWordTime, pcOneWordTime) = timeAlgorithms<1>(argv[i], timeLimit);
+        double ourTwoWordTime, pcTwoWordTime;
+        tie(ourTwoWordTime, pcTwoWordTime) = timeAlgorithms<2>(argv[i], timeLimit);
+
+        cout << argv[i] << ":\n";
+        printComparison("Our algorithm", ourOneWordTime, ourTwoWordTime);
+        printComparison("PC algorithm", pcOneWordTime, pcTwoWordTime);
+    }
+
+    return 0;
+}
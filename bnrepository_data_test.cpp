@@ -1,21 +1,79 @@
 #include "bayesian_oracle.hpp"
 #include "bayesian_solve.hpp"
 #include "file.hpp"
+#include "fisher_z.hpp"
+#include "g_test.hpp"
 #include "pc_algorithm.hpp"
+#include "pearson_chisq.hpp"
+#include "progressive_chisq.hpp"
 
-template <typename F>
+// Maximum size of the bitmap index of the data in bytes
+const size_t BitmapIndexMemoryBudget = (size_t)1 << 30;
+
+// Data taking at least this many bytes is bit-packed, trading some counting
+// speed for a several times smaller memory footprint
+const size_t PackedDataMinSize = (size_t)1 << 30;
+
+// Fraction of the data points in the first subsample of the progressive test
+// and the seed for choosing the subsamples
+const double ProgressiveFraction = 0.1;
+const uint64_t ProgressiveSeed = 0;
+
+// Maximum size of the contingency table cache or the regression cache of each
+// algorithm run in bytes
+const size_t TableCacheMemoryCap = (size_t)1 << 30;
+
+enum class TestType {
+    Pearson,
+    Progressive,
+    G,
+    FisherZ
+};
+
+// The data for the independence tests; correlations are used by the Fisher-z
+// test and data and bitmapIndex by the others
+struct TestInput {
+    TestType testType;
+    double alpha;
+    Data data;
+    unique_ptr<BitmapIndex> bitmapIndex;
+    unique_ptr<CorrelationMatrix> correlations;
+};
+
+template <int W, typename F>
 void testAlgorithm(
-    const Digraph& cpdag,
-    const Data& data,
+    const Digraph<W>& cpdag,
+    const TestInput& input,
     double timeLimit,
     F algo
 ) {
-    BayesianOracle oracle(data, timeLimit);
-    Digraph learnedCPDAG;
+    unique_ptr<ContingencyCounter<W>> counter;
+    unique_ptr<IndependenceTest<W>> test;
+    ProgressiveChiSquaredTest<W>* progressive = nullptr;
+    if(input.testType == TestType::FisherZ) {
+        test.reset(new FisherZTest<W>(*input.correlations, input.alpha, TableCacheMemoryCap));
+    } else {
+        counter.reset(new ContingencyCounter<W>(
+            input.data, input.bitmapIndex.get(), TableCacheMemoryCap
+        ));
+        if(input.testType == TestType::Pearson) {
+            test.reset(new PearsonChiSquaredTest<W>(*counter, input.alpha));
+        } else if(input.testType == TestType::Progressive) {
+            progressive = new ProgressiveChiSquaredTest<W>(
+                *counter, input.alpha, ProgressiveFraction, ProgressiveSeed
+            );
+            test.reset(progressive);
+        } else {
+            test.reset(new GTest<W>(*counter, input.alpha));
+        }
+    }
+
+    BayesianOracle<W> oracle(*test, timeLimit);
+    Digraph<W> learnedCPDAG;
     bool ok = true;
     try {
         learnedCPDAG = algo(oracle);
-    } catch(BayesianOracle::TimeLimitExceeded) {
+    } catch(typename BayesianOracle<W>::TimeLimitExceeded) {
         cout << "  TIMEOUT\n";
         ok = false;
     }
@@ -40,31 +98,110 @@ void testAlgorithm(
             cout << "    " << i << ": " << qc[i] << '\n';
         }
     }
+
+    if(progressive) {
+        vector<int> sizes = progressive->stageSizes();
+        vector<uint64_t> counts = progressive->decidedCounts();
+        cout << "  Pair tests decided by sample size:\n";
+        for(int k = 0; k < (int)sizes.size(); ++k) {
+            cout << "    " << sizes[k] << ": " << counts[k] << '\n';
+        }
+    }
+
+    if(!counter) {
+        return;
+    }
+    typename ContingencyCounter<W>::Stats stats = counter->stats();
+    cout << "  Contingency table cache:\n";
+    cout << "    Hits: " << stats.hitCount << '\n';
+    cout << "    Marginalized from supersets: " << stats.supersetHitCount << '\n';
+    cout << "    Misses: " << stats.missCount << '\n';
+    cout << "    Evictions: " << stats.evictionCount << '\n';
+    cout << "    Memory usage: " << stats.memoryUsage / 1024 << " KiB\n";
+}
+
+template <int W>
+void run(
+    string filename,
+    const TestInput& input,
+    double timeLimit,
+    ThreadPool& pool
+) {
+    Digraph<W> cpdag = readBnRepositoryNet<W>(filename).second;
+
+    int threadCount = pool.threadCount();
+
+    cout << "Our algorithm (" << threadCount << " threads):\n";
+    testAlgorithm(cpdag, input, timeLimit, [&](BayesianOracle<W>& oracle) {
+        return get<0>(reconstructBayesianNetwork(oracle, &pool));
+    });
+
+    cout << '\n';
+    cout << "PC algorithm:\n";
+    testAlgorithm(cpdag, input, timeLimit, [&](BayesianOracle<W>& oracle) {
+        return pcAlgorithm(oracle);
+    });
+
+    cout << '\n';
+    cout << "PC-stable algorithm (" << threadCount << " threads):\n";
+    testAlgorithm(cpdag, input, timeLimit, [&](BayesianOracle<W>& oracle) {
+        return pcStableAlgorithm(oracle, pool);
+    });
 }
 
 int main(int argc, char* argv[]) {
-    if(argc != 3) {
-        cerr << "Usage: ./bnrepository_test <filename> <time limit>\n";
+    if(argc < 3 || argc > 6) {
+        cerr << "Usage: ./bnrepository_data_test <filename> <time limit> [thread count] [significance level] [pearson|progressive|g|fisher-z]\n";
         CHECK(false);
     }
 
     double timeLimit = parseString<double>(argv[2]);
     CHECK(isfinite(timeLimit) && timeLimit > 0.0);
 
-    Digraph cpdag = readBnRepositoryNet(argv[1]).second;
+    int threadCount = argc >= 4 ? parseString<int>(argv[3]) : (int)thread::hardware_concurrency();
+    CHECK(threadCount >= 1);
+    ThreadPool pool(threadCount);
 
-    Data data = readData(cin);
-    CHECK((int)data.catCounts.size() == cpdag.vertCount());
+    TestInput input;
+    input.alpha = argc >= 5 ? parseString<double>(argv[4]) : 0.05;
+    CHECK(input.alpha > 0.0 && input.alpha < 1.0);
 
-    cout << "Our algorithm:\n";
-    testAlgorithm(cpdag, data, timeLimit, [&](BayesianOracle& oracle) {
-        return get<0>(reconstructBayesianNetwork(oracle));
-    });
+    string testName = argc >= 6 ? argv[5] : "pearson";
+    if(testName == "pearson") {
+        input.testType = TestType::Pearson;
+    } else if(testName == "progressive") {
+        input.testType = TestType::Progressive;
+    } else if(testName == "g") {
+        input.testType = TestType::G;
+    } else if(testName == "fisher-z") {
+        input.testType = TestType::FisherZ;
+    } else {
+        cerr << "Unknown independence test '" << testName << "'\n";
+        CHECK(false);
+    }
 
-    cout << '\n';
-    cout << "PC algorithm:\n";
-    testAlgorithm(cpdag, data, timeLimit, [&](BayesianOracle& oracle) {
-        return pcAlgorithm(oracle);
+    int varCount;
+    if(input.testType == TestType::FisherZ) {
+        ContinuousData data = readContinuousData(cin);
+        input.correlations.reset(new CorrelationMatrix(data));
+        varCount = data.varCount();
+    } else {
+        // Standard input redirected from a binary data file is mapped to
+        // memory instead of parsed
+        if(!tryMapBinaryData(STDIN_FILENO, input.data)) {
+            input.data = readData(cin, &pool);
+        }
+        if(input.data.memoryUsage() >= PackedDataMinSize) {
+            input.data = input.data.pack();
+        }
+        input.bitmapIndex.reset(new BitmapIndex(input.data, BitmapIndexMemoryBudget));
+        varCount = input.data.varCount();
+    }
+
+    int vertCount = readBnRepositoryNetVertCount(argv[1]);
+    CHECK(varCount == vertCount);
+    dispatchBitsetWordCount(vertCount, [&](auto words) {
+        run<decltype(words)::value>(argv[1], input, timeLimit, pool);
     });
 
     return 0;
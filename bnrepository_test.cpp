@@ -3,19 +3,19 @@
 #include "file.hpp"
 #include "pc_algorithm.hpp"
 
-template <typename F>
+template <int W, typename F>
 static void testAlgorithm(
-    const Digraph& dag,
-    const Digraph& cpdag,
+    const Digraph<W>& dag,
+    const Digraph<W>& cpdag,
     double timeLimit,
     F algo
 ) {
-    BayesianOracle oracle(dag, timeLimit);
-    Digraph learnedCPDAG;
+    BayesianOracle<W> oracle(dag, timeLimit);
+    Digraph<W> learnedCPDAG;
     bool ok = true;
     try {
         learnedCPDAG = algo(oracle);
-    } catch(BayesianOracle::TimeLimitExceeded) {
+    } catch(typename BayesianOracle<W>::TimeLimitExceeded) {
         cout << "  TIMEOUT\n";
         ok = false;
     }
@@ -31,27 +31,72 @@ static void testAlgorithm(
     }
 }
 
+template <int W>
+static void run(
+    string filename,
+    double timeLimit,
+    int threadCount,
+    int concurrentTWCount,
+    size_t memoCap,
+    string spillDirectory
+) {
+    Digraph<W> dag, cpdag;
+    tie(dag, cpdag) = readBnRepositoryNet<W>(filename);
+
+    ThreadPool pool(threadCount);
+
+    cout << "Our algorithm (" << threadCount << " threads, ";
+    cout << concurrentTWCount << " concurrent treewidth bounds):\n";
+    MemoBudget memoBudget(memoCap, spillDirectory);
+    testAlgorithm(dag, cpdag, timeLimit, [&](BayesianOracle<W>& oracle) {
+        return get<0>(reconstructBayesianNetwork(oracle, &pool, concurrentTWCount, &memoBudget));
+    });
+    cout << "  Solver memo tables:\n";
+    cout << "    Peak memory usage: " << memoBudget.peakMemoryUsage() / 1024 << " KiB\n";
+    cout << "    Evictions: " << memoBudget.evictionCount() << '\n';
+
+    cout << '\n';
+    cout << "PC algorithm:\n";
+    testAlgorithm(dag, cpdag, timeLimit, [&](BayesianOracle<W>& oracle) {
+        return pcAlgorithm(oracle);
+    });
+
+    cout << '\n';
+    cout << "PC-stable algorithm (" << threadCount << " threads):\n";
+    testAlgorithm(dag, cpdag, timeLimit, [&](BayesianOracle<W>& oracle) {
+        return pcStableAlgorithm(oracle, pool);
+    });
+}
+
 int main(int argc, char* argv[]) {
-    if(argc != 3) {
-        cerr << "Usage: ./bnrepository_test <filename> <time limit>\n";
+    if(argc < 3 || argc > 7) {
+        cerr << "Usage: ./bnrepository_test <filename> <time limit> [thread count] [concurrent treewidth bounds] [memo memory cap in MiB] [spill directory]\n";
         CHECK(false);
     }
 
     double timeLimit = parseString<double>(argv[2]);
     CHECK(isfinite(timeLimit) && timeLimit > 0.0);
 
-    Digraph dag, cpdag;
-    tie(dag, cpdag) = readBnRepositoryNet(argv[1]);
+    int threadCount = argc >= 4 ? parseString<int>(argv[3]) : (int)thread::hardware_concurrency();
+    CHECK(threadCount >= 1);
 
-    cout << "Our algorithm:\n";
-    testAlgorithm(dag, cpdag, timeLimit, [&](BayesianOracle& oracle) {
-        return get<0>(reconstructBayesianNetwork(oracle));
-    });
+    int concurrentTWCount = argc >= 5 ? parseString<int>(argv[4]) : 1;
+    CHECK(concurrentTWCount >= 1);
 
-    cout << '\n';
-    cout << "PC algorithm:\n";
-    testAlgorithm(dag, cpdag, timeLimit, [&](BayesianOracle& oracle) {
-        return pcAlgorithm(oracle);
+    size_t memoCap = SIZE_MAX;
+    if(argc >= 6) {
+        double memoCapMiB = parseString<double>(argv[5]);
+        CHECK(isfinite(memoCapMiB) && memoCapMiB > 0.0);
+        memoCap = (size_t)(memoCapMiB * 1024.0 * 1024.0);
+    }
+
+    string spillDirectory = argc >= 7 ? argv[6] : "";
+
+    int vertCount = readBnRepositoryNetVertCount(argv[1]);
+    dispatchBitsetWordCount(vertCount, [&](auto words) {
+        run<decltype(words)::value>(
+            argv[1], timeLimit, threadCount, concurrentTWCount, memoCap, spillDirectory
+        );
     });
 
     return 0;
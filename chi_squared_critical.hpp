@@ -0,0 +1,98 @@
+#pragma once
+
+#include "common.hpp"
+
+#include <boost/math/distributions/chi_squared.hpp>
+
+// Critical values of the chi-squared distribution at significance level alpha,
+// that is, the upper alpha-quantiles for different degrees of freedom. The
+// values are computed on the first use and memoized. Thread-safe.
+class ChiSquaredCriticalValues {
+public:
+    ChiSquaredCriticalValues(double alpha)
+        : alpha_(alpha),
+          table_(new atomic<double>[TableSize])
+    {
+        CHECK(alpha > 0.0 && alpha < 1.0);
+        for(int i = 0; i < TableSize; ++i) {
+            table_[i].store(0.0, memory_order_relaxed);
+        }
+    }
+
+    ChiSquaredCriticalValues(const ChiSquaredCriticalValues&) = delete;
+    ChiSquaredCriticalValues(ChiSquaredCriticalValues&&) = delete;
+    ChiSquaredCriticalValues& operator=(const ChiSquaredCriticalValues&) = delete;
+    ChiSquaredCriticalValues& operator=(ChiSquaredCriticalValues&&) = delete;
+
+    double alpha() const {
+        return alpha_;
+    }
+
+    double get(double freedom) {
+        if(freedom >= 1.0 && freedom < (double)TableSize && freedom == floor(freedom)) {
+            // The critical values are positive, so zero marks an empty slot.
+            // Concurrent threads may compute the same value, which is
+            // harmless.
+            atomic<double>& slot = table_[(int)freedom];
+            double ret = slot.load(memory_order_relaxed);
+            if(ret == 0.0) {
+                ret = compute_(freedom);
+                slot.store(ret, memory_order_relaxed);
+            }
+            return ret;
+        }
+
+        {
+            lock_guard<mutex> lock(otherMutex_);
+            auto it = other_.find(freedom);
+            if(it != other_.end()) {
+                return it->second;
+            }
+        }
+        double ret = compute_(freedom);
+        lock_guard<mutex> lock(otherMutex_);
+        other_.emplace(freedom, ret);
+        return ret;
+    }
+
+private:
+    // The integral degrees of freedom below TableSize are stored in a table
+    // and the others in a map
+    static constexpr int TableSize = 4096;
+
+    double alpha_;
+    unique_ptr<atomic<double>[]> table_;
+    mutex otherMutex_;
+    unordered_map<double, double> other_;
+
+    double compute_(double freedom) const {
+        // The upper tail quantile avoids the rounding of 1 - alpha for small
+        // alpha
+        boost::math::chi_squared_distribution<> dist(freedom);
+        return boost::math::quantile(boost::math::complement(dist, alpha_));
+    }
+};
+
+// Returns the critical value of the chi-squared distribution with given
+// degrees of freedom at significance level alpha. The values are memoized in
+// a process-wide ChiSquaredCriticalValues table for each alpha.
+inline double chiSquaredCriticalValue(double freedom, double alpha) {
+    // The tables are never destroyed, so the pointers stay valid
+    static mutex tablesMutex;
+    static map<double, ChiSquaredCriticalValues*> tables;
+
+    // The most recently used table of the thread, to avoid the lock
+    static thread_local double lastAlpha = -1.0;
+    static thread_local ChiSquaredCriticalValues* lastTable = nullptr;
+
+    if(alpha != lastAlpha) {
+        lock_guard<mutex> lock(tablesMutex);
+        ChiSquaredCriticalValues*& table = tables[alpha];
+        if(!table) {
+            table = new ChiSquaredCriticalValues(alpha);
+        }
+        lastAlpha = alpha;
+        lastTable = table;
+    }
+    return lastTable->get(freedom);
+}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <algorithm>
+#include <atomic>
 #include <chrono>
 #include <cmath>
 #include <cstdint>
@@ -12,9 +13,12 @@
 #include <functional>
 #include <iostream>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <queue>
 #include <random>
 #include <sstream>
+#include <thread>
 #include <tuple>
 #include <unordered_map>
 #include <unordered_set>
@@ -52,6 +56,34 @@ inline void check(
 
 #define CHECK(condition) check((condition), #condition, __FILE__, __LINE__)
 
+// The instruction set levels of the SIMD kernels: AVX512 requires the
+// AVX-512 F, BW, CD and VPOPCNTDQ extensions and AVX2 also POPCNT
+enum class SimdLevel {
+    Scalar,
+    AVX2,
+    AVX512
+};
+
+// The best level supported by the CPU, detected on the first call
+inline SimdLevel simdLevel() {
+    static const SimdLevel level = []() {
+        __builtin_cpu_init();
+        if(
+            __builtin_cpu_supports("avx512f") &&
+            __builtin_cpu_supports("avx512bw") &&
+            __builtin_cpu_supports("avx512cd") &&
+            __builtin_cpu_supports("avx512vpopcntdq")
+        ) {
+            return SimdLevel::AVX512;
+        }
+        if(__builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt")) {
+            return SimdLevel::AVX2;
+        }
+        return SimdLevel::Scalar;
+    }();
+    return level;
+}
+
 template <typename T>
 inline T parseString(const string& str) {
     T ret;
@@ -76,6 +108,36 @@ private:
     chrono::steady_clock::time_point start_;
 };
 
+// Mutex for very short critical sections, usable with lock_guard. A waiting
+// thread yields after spinning for a while, in case the thread holding the
+// lock has been preempted (when there are more threads than cores).
+class SpinLock {
+public:
+    SpinLock() : locked_(false) {}
+
+    void lock() {
+        while(locked_.exchange(true, memory_order_acquire)) {
+            int spinCount = 0;
+            while(locked_.load(memory_order_relaxed)) {
+                if(spinCount < MaxSpinCount) {
+                    _mm_pause();
+                    ++spinCount;
+                } else {
+                    this_thread::yield();
+                }
+            }
+        }
+    }
+    void unlock() {
+        locked_.store(false, memory_order_release);
+    }
+
+private:
+    static constexpr int MaxSpinCount = 64;
+
+    atomic<bool> locked_;
+};
+
 template <typename T>
 inline void hashCombine(size_t& x, const T& val) {
     x ^= hash<T>()(val) + 0x9e3779b9 + (x << 6) + (x >> 2);
@@ -0,0 +1,91 @@
+#pragma once
+
+#include "flat_hash_map.hpp"
+
+// Thread-safe hash map to which values are only added, for trivially
+// destructible keys and values. The keys are split to shards by their hash,
+// each a FlatHashMap protected by its own lock. If a memory budget is given,
+// the shards evict entries instead of growing beyond it, so a value added
+// may later be missing.
+template <typename K, typename V>
+class ConcurrentMap {
+public:
+    ConcurrentMap(MemoBudget* budget = nullptr)
+        : shards_(new Shard[ShardCount])
+    {
+        for(int i = 0; i < ShardCount; ++i) {
+            shards_[i].map.setBudget(budget);
+        }
+    }
+
+    ConcurrentMap(const ConcurrentMap&) = delete;
+    ConcurrentMap(ConcurrentMap&&) = delete;
+    ConcurrentMap& operator=(const ConcurrentMap&) = delete;
+    ConcurrentMap& operator=(ConcurrentMap&&) = delete;
+
+    // Returns true and sets value to the value of key if it is in the map
+    bool find(const K& key, V& value) {
+        uint64_t hash = hashKey(key);
+        Shard& shard = shards_[shardIdx_(hash)];
+        lock_guard<SpinLock> lock(shard.lock);
+        V* found = shard.map.find(key, hash);
+        if(!found) {
+            return false;
+        }
+        value = *found;
+        return true;
+    }
+
+    // Adds key with value if key is not already in the map
+    void insert(const K& key, const V& value) {
+        uint64_t hash = hashKey(key);
+        Shard& shard = shards_[shardIdx_(hash)];
+        lock_guard<SpinLock> lock(shard.lock);
+        shard.map.insert(key, value, hash);
+    }
+
+    // Adds key with value if key is not already in the map, and otherwise
+    // calls update(v) for the value v of key in the map
+    template <typename F>
+    void insertOrUpdate(const K& key, const V& value, F update) {
+        uint64_t hash = hashKey(key);
+        Shard& shard = shards_[shardIdx_(hash)];
+        lock_guard<SpinLock> lock(shard.lock);
+        pair<V*, bool> result = shard.map.insert(key, value, hash);
+        if(!result.second) {
+            update(*result.first);
+        }
+    }
+
+    size_t size() const {
+        size_t ret = 0;
+        for(int i = 0; i < ShardCount; ++i) {
+            lock_guard<SpinLock> lock(shards_[i].lock);
+            ret += shards_[i].map.size();
+        }
+        return ret;
+    }
+    size_t memoryUsage() const {
+        size_t ret = sizeof(Shard) * ShardCount;
+        for(int i = 0; i < ShardCount; ++i) {
+            lock_guard<SpinLock> lock(shards_[i].lock);
+            ret += shards_[i].map.memoryUsage();
+        }
+        return ret;
+    }
+
+private:
+    static constexpr int ShardBits = 6;
+    static constexpr int ShardCount = 1 << ShardBits;
+    struct Shard {
+        mutable SpinLock lock;
+        FlatHashMap<K, V> map;
+    };
+    unique_ptr<Shard[]> shards_;
+
+    // The shard is chosen by the high bits of the hash, as the maps use the
+    // low bits
+    static int shardIdx_(uint64_t hash) {
+        return (int)(hash >> (64 - ShardBits));
+    }
+};
@@ -0,0 +1,654 @@
+#pragma once
+
+#include "bitset.hpp"
+#include "data.hpp"
+
+// Partition of the data points by the values of the variables in a
+// conditioning set X. Computed once for X and shared by the contingency
+// tables of all the variable pairs tested against X.
+struct Strata {
+    // The product of the category counts of the variables in X
+    double configCount;
+
+    // The number of strata; the stratum indices are in [0, count). Some strata
+    // may be empty.
+    int count;
+
+    // The stratum index of each data point
+    vector<uint32_t> ids;
+
+    // If count <= NarrowMaxCount, the stratum indices as uint8_t padded with
+    // zeros to a multiple of 64 data points for the bitmap counting kernels.
+    // Otherwise empty.
+    static constexpr int NarrowMaxCount = 16;
+    vector<uint8_t> narrowIds;
+};
+
+// The contingency tables of variables a and b in each stratum: the number of
+// data points in stratum s with values aVal and bVal is
+// counts[(s * bCatCount + bVal) * aCatCount + aVal]. If sparse is set, counts
+// is unused, and the nonzero counts are instead given in sparseCells as pairs
+// of the index above and the count in increasing order of the index.
+struct ContingencyTables {
+    int aCatCount;
+    int bCatCount;
+    int stratumCount;
+    vector<uint32_t> counts;
+    bool sparse;
+    vector<pair<uint64_t, uint32_t>> sparseCells;
+};
+
+namespace contingency_ {
+
+// Open addressing hash table mapping 64-bit keys to consecutive indices in
+// the order of insertion
+class KeyIndexer {
+public:
+    KeyIndexer(int maxKeyCount) : count_(0) {
+        int capacity = 16;
+        while(capacity < 2 * maxKeyCount) {
+            capacity *= 2;
+        }
+        mask_ = (uint64_t)capacity - 1;
+        keys_.resize(capacity);
+        indices_.resize(capacity, -1);
+    }
+
+    uint32_t index(uint64_t key) {
+        uint64_t pos = (key * (uint64_t)0x9e3779b97f4a7c15) >> 20;
+        while(true) {
+            pos &= mask_;
+            if(indices_[pos] == -1) {
+                keys_[pos] = key;
+                indices_[pos] = count_;
+                return (uint32_t)count_++;
+            }
+            if(keys_[pos] == key) {
+                return (uint32_t)indices_[pos];
+            }
+            ++pos;
+        }
+    }
+
+    int count() const {
+        return count_;
+    }
+
+private:
+    uint64_t mask_;
+    vector<uint64_t> keys_;
+    vector<int> indices_;
+    int count_;
+};
+
+// Replaces the keys by consecutive indices of the distinct keys; returns the
+// number of distinct keys
+inline uint64_t compactKeys(vector<uint64_t>& keys) {
+    KeyIndexer indexer((int)keys.size());
+    for(uint64_t& key : keys) {
+        key = indexer.index(key);
+    }
+    return (uint64_t)indexer.count();
+}
+
+// The counting kernels increment
+// counts[ids[i] * cellCount + bColumn[i] * aCatCount + aColumn[i]] for each
+// data point i in [0, pointCount), where cellCount = aCatCount * bCatCount.
+
+template <typename T>
+void countCellsScalar(
+    const uint32_t* ids,
+    const T* aColumn,
+    const T* bColumn,
+    int pointCount,
+    uint32_t aCatCount,
+    uint32_t cellCount,
+    uint32_t* counts
+) {
+    for(int i = 0; i < pointCount; ++i) {
+        ++counts[ids[i] * cellCount + (uint32_t)bColumn[i] * aCatCount + (uint32_t)aColumn[i]];
+    }
+}
+
+// The masked forms avoid spurious uninitialized warnings of GCC
+__attribute__((target("avx512f")))
+inline __m512i loadValuesAVX512(const uint8_t* src) {
+    return _mm512_maskz_cvtepu8_epi32(0xffff, _mm_loadu_si128((const __m128i*)src));
+}
+__attribute__((target("avx512f")))
+inline __m512i loadValuesAVX512(const uint16_t* src) {
+    return _mm512_maskz_cvtepu16_epi32(0xffff, _mm256_loadu_si256((const __m256i*)src));
+}
+
+// Histogram kernel handling 16 data points at a time with gather and scatter.
+// Lanes hitting the same cell are resolved with conflict detection: each lane
+// adds one plus the number of preceding lanes with the same cell, and as the
+// scatter writes the lanes in order, the last one of them wins.
+template <typename T>
+__attribute__((target("avx512f,avx512cd,avx512vpopcntdq")))
+void countCellsAVX512(
+    const uint32_t* ids,
+    const T* aColumn,
+    const T* bColumn,
+    int pointCount,
+    uint32_t aCatCount,
+    uint32_t cellCount,
+    uint32_t* counts
+) {
+    __m512i aCatCountVec = _mm512_set1_epi32((int)aCatCount);
+    __m512i cellCountVec = _mm512_set1_epi32((int)cellCount);
+    __m512i one = _mm512_set1_epi32(1);
+
+    int i = 0;
+    for(; i + 16 <= pointCount; i += 16) {
+        __m512i cells = _mm512_add_epi32(
+            _mm512_add_epi32(
+                _mm512_mullo_epi32(_mm512_loadu_si512(ids + i), cellCountVec),
+                _mm512_mullo_epi32(loadValuesAVX512(bColumn + i), aCatCountVec)
+            ),
+            loadValuesAVX512(aColumn + i)
+        );
+        __m512i incs = _mm512_add_epi32(_mm512_popcnt_epi32(_mm512_conflict_epi32(cells)), one);
+        __m512i vals = _mm512_mask_i32gather_epi32(
+            _mm512_setzero_si512(), 0xffff, cells, (const int*)counts, 4
+        );
+        _mm512_i32scatter_epi32((int*)counts, cells, _mm512_add_epi32(vals, incs), 4);
+    }
+    countCellsScalar(
+        ids + i, aColumn + i, bColumn + i, pointCount - i, aCatCount, cellCount, counts
+    );
+}
+
+// Maximum number of mask operations per 64 data points in the bitmap kernels
+constexpr int BitmapMaxCost = 64;
+
+inline int bitmapCost(int stratumCount, int aCatCount, int bCatCount) {
+    return stratumCount * bCatCount * (aCatCount + 1) + stratumCount + aCatCount + bCatCount;
+}
+
+// Adds the counts of the cells of a block of 64 data points given as bitmasks
+// of the points in each stratum and each category of a and b
+__attribute__((target("popcnt")))
+inline void addBitmapCounts(
+    const uint64_t* stratumMasks,
+    const uint64_t* aMasks,
+    const uint64_t* bMasks,
+    int stratumCount,
+    int aCatCount,
+    int bCatCount,
+    uint32_t* counts
+) {
+    for(int s = 0; s < stratumCount; ++s) {
+        for(int bVal = 0; bVal < bCatCount; ++bVal) {
+            uint64_t mask = stratumMasks[s] & bMasks[bVal];
+            for(int aVal = 0; aVal < aCatCount; ++aVal) {
+                *counts++ += (uint32_t)_mm_popcnt_u64(mask & aMasks[aVal]);
+            }
+        }
+    }
+}
+
+// Bitmap kernels for small tables: for each block of 64 data points, the
+// count of each cell is the popcount of the intersection of the bitmasks of
+// its stratum and categories. Require bitmapCost(...) <= BitmapMaxCost and
+// columns readable up to the next multiple of 64 data points.
+
+__attribute__((target("avx512f,avx512bw,popcnt")))
+inline void countCellsBitmapAVX512(
+    const uint8_t* narrowIds,
+    const uint8_t* aColumn,
+    const uint8_t* bColumn,
+    int pointCount,
+    int stratumCount,
+    int aCatCount,
+    int bCatCount,
+    uint32_t* counts
+) {
+    uint64_t stratumMasks[BitmapMaxCost];
+    uint64_t aMasks[BitmapMaxCost];
+    uint64_t bMasks[BitmapMaxCost];
+    for(int i = 0; i < pointCount; i += 64) {
+        uint64_t valid = pointCount - i >= 64 ? ~(uint64_t)0 : ((uint64_t)1 << (pointCount - i)) - 1;
+        __m512i ids = _mm512_loadu_si512(narrowIds + i);
+        __m512i aVals = _mm512_loadu_si512(aColumn + i);
+        __m512i bVals = _mm512_loadu_si512(bColumn + i);
+        for(int s = 0; s < stratumCount; ++s) {
+            stratumMasks[s] = valid & _mm512_cmpeq_epi8_mask(ids, _mm512_set1_epi8((char)s));
+        }
+        for(int aVal = 0; aVal < aCatCount; ++aVal) {
+            aMasks[aVal] = _mm512_cmpeq_epi8_mask(aVals, _mm512_set1_epi8((char)aVal));
+        }
+        for(int bVal = 0; bVal < bCatCount; ++bVal) {
+            bMasks[bVal] = _mm512_cmpeq_epi8_mask(bVals, _mm512_set1_epi8((char)bVal));
+        }
+        addBitmapCounts(stratumMasks, aMasks, bMasks, stratumCount, aCatCount, bCatCount, counts);
+    }
+}
+
+__attribute__((target("avx2")))
+inline uint64_t equalMaskAVX2(__m256i lo, __m256i hi, int val) {
+    __m256i valVec = _mm256_set1_epi8((char)val);
+    uint64_t loMask = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(lo, valVec));
+    uint64_t hiMask = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(hi, valVec));
+    return loMask | (hiMask << 32);
+}
+
+__attribute__((target("avx2,popcnt")))
+inline void countCellsBitmapAVX2(
+    const uint8_t* narrowIds,
+    const uint8_t* aColumn,
+    const uint8_t* bColumn,
+    int pointCount,
+    int stratumCount,
+    int aCatCount,
+    int bCatCount,
+    uint32_t* counts
+) {
+    uint64_t stratumMasks[BitmapMaxCost];
+    uint64_t aMasks[BitmapMaxCost];
+    uint64_t bMasks[BitmapMaxCost];
+    for(int i = 0; i < pointCount; i += 64) {
+        uint64_t valid = pointCount - i >= 64 ? ~(uint64_t)0 : ((uint64_t)1 << (pointCount - i)) - 1;
+        __m256i idsLo = _mm256_loadu_si256((const __m256i*)(narrowIds + i));
+        __m256i idsHi = _mm256_loadu_si256((const __m256i*)(narrowIds + i + 32));
+        __m256i aLo = _mm256_loadu_si256((const __m256i*)(aColumn + i));
+        __m256i aHi = _mm256_loadu_si256((const __m256i*)(aColumn + i + 32));
+        __m256i bLo = _mm256_loadu_si256((const __m256i*)(bColumn + i));
+        __m256i bHi = _mm256_loadu_si256((const __m256i*)(bColumn + i + 32));
+        for(int s = 0; s < stratumCount; ++s) {
+            stratumMasks[s] = valid & equalMaskAVX2(idsLo, idsHi, s);
+        }
+        for(int aVal = 0; aVal < aCatCount; ++aVal) {
+            aMasks[aVal] = equalMaskAVX2(aLo, aHi, aVal);
+        }
+        for(int bVal = 0; bVal < bCatCount; ++bVal) {
+            bMasks[bVal] = equalMaskAVX2(bLo, bHi, bVal);
+        }
+        addBitmapCounts(stratumMasks, aMasks, bMasks, stratumCount, aCatCount, bCatCount, counts);
+    }
+}
+
+// Runs a bitmap kernel if one applies; returns false otherwise. narrowIds is
+// null if the strata have no narrow indices.
+inline bool tryCountCellsBitmap(
+    const uint8_t* narrowIds,
+    int stratumCount,
+    const uint8_t* aColumn,
+    const uint8_t* bColumn,
+    int pointCount,
+    int aCatCount,
+    int bCatCount,
+    uint32_t* counts
+) {
+    if(!narrowIds || bitmapCost(stratumCount, aCatCount, bCatCount) > BitmapMaxCost) {
+        return false;
+    }
+    switch(simdLevel()) {
+    case SimdLevel::AVX512:
+        countCellsBitmapAVX512(
+            narrowIds, aColumn, bColumn, pointCount, stratumCount, aCatCount, bCatCount, counts
+        );
+        return true;
+    case SimdLevel::AVX2:
+        countCellsBitmapAVX2(
+            narrowIds, aColumn, bColumn, pointCount, stratumCount, aCatCount, bCatCount, counts
+        );
+        return true;
+    default:
+        return false;
+    }
+}
+inline bool tryCountCellsBitmap(
+    const uint8_t*, int, const uint16_t*, const uint16_t*, int, int, int, uint32_t*
+) {
+    return false;
+}
+
+// Bitmap kernels for binary a and b bit-packed at one bit per value: the
+// packed words are the masks of category 1 and their complements the masks
+// of category 0, so only the stratum masks have to be computed
+
+__attribute__((target("avx512f,avx512bw,popcnt")))
+inline void countCellsPackedBinaryAVX512(
+    const uint8_t* narrowIds,
+    const uint64_t* aWords,
+    const uint64_t* bWords,
+    int pointCount,
+    int stratumCount,
+    uint32_t* counts
+) {
+    uint64_t stratumMasks[BitmapMaxCost];
+    for(int i = 0; i < pointCount; i += 64) {
+        uint64_t valid = pointCount - i >= 64 ? ~(uint64_t)0 : ((uint64_t)1 << (pointCount - i)) - 1;
+        __m512i ids = _mm512_loadu_si512(narrowIds + i);
+        for(int s = 0; s < stratumCount; ++s) {
+            stratumMasks[s] = valid & _mm512_cmpeq_epi8_mask(ids, _mm512_set1_epi8((char)s));
+        }
+        uint64_t aMasks[2] = {~aWords[i >> 6], aWords[i >> 6]};
+        uint64_t bMasks[2] = {~bWords[i >> 6], bWords[i >> 6]};
+        addBitmapCounts(stratumMasks, aMasks, bMasks, stratumCount, 2, 2, counts);
+    }
+}
+
+__attribute__((target("avx2,popcnt")))
+inline void countCellsPackedBinaryAVX2(
+    const uint8_t* narrowIds,
+    const uint64_t* aWords,
+    const uint64_t* bWords,
+    int pointCount,
+    int stratumCount,
+    uint32_t* counts
+) {
+    uint64_t stratumMasks[BitmapMaxCost];
+    for(int i = 0; i < pointCount; i += 64) {
+        uint64_t valid = pointCount - i >= 64 ? ~(uint64_t)0 : ((uint64_t)1 << (pointCount - i)) - 1;
+        __m256i idsLo = _mm256_loadu_si256((const __m256i*)(narrowIds + i));
+        __m256i idsHi = _mm256_loadu_si256((const __m256i*)(narrowIds + i + 32));
+        for(int s = 0; s < stratumCount; ++s) {
+            stratumMasks[s] = valid & equalMaskAVX2(idsLo, idsHi, s);
+        }
+        uint64_t aMasks[2] = {~aWords[i >> 6], aWords[i >> 6]};
+        uint64_t bMasks[2] = {~bWords[i >> 6], bWords[i >> 6]};
+        addBitmapCounts(stratumMasks, aMasks, bMasks, stratumCount, 2, 2, counts);
+    }
+}
+
+// Runs a packed binary kernel if one applies; returns false otherwise
+inline bool tryCountCellsPackedBinary(
+    const Data& data,
+    const Strata& strata,
+    int a,
+    int b,
+    uint32_t* counts
+) {
+    // Variables with one category are also packed at one bit per value, but
+    // the kernels write tables of two categories
+    if(
+        !data.isPacked() ||
+        data.catCount(a) != 2 ||
+        data.catCount(b) != 2 ||
+        strata.narrowIds.empty() ||
+        bitmapCost(strata.count, 2, 2) > BitmapMaxCost
+    ) {
+        return false;
+    }
+    const uint8_t* narrowIds = strata.narrowIds.data();
+    const uint64_t* aWords = data.packedColumn(a);
+    const uint64_t* bWords = data.packedColumn(b);
+    int pointCount = data.pointCount();
+    switch(simdLevel()) {
+    case SimdLevel::AVX512:
+        countCellsPackedBinaryAVX512(narrowIds, aWords, bWords, pointCount, strata.count, counts);
+        return true;
+    case SimdLevel::AVX2:
+        countCellsPackedBinaryAVX2(narrowIds, aWords, bWords, pointCount, strata.count, counts);
+        return true;
+    default:
+        return false;
+    }
+}
+
+// The number of data points processed at once, a multiple of 64. The decoded
+// values of a block of a packed column stay in the L1 cache.
+const int CountingBlockSize = 2048;
+
+// The tables are counted sparsely if they would have more cells than this
+// times the number of data points. The dense tables are also limited to
+// INT32_MAX cells, as the cells are indexed with 32-bit integers.
+const int SparseTableFactor = 4;
+
+inline bool useSparseTables(int pointCount, int stratumCount, int aCatCount, int bCatCount) {
+    double cellCount = (double)stratumCount * (double)aCatCount * (double)bCatCount;
+    return cellCount > (double)SparseTableFactor * (double)pointCount || cellCount > (double)INT32_MAX;
+}
+
+// Counts the nonzero cells of the tables with a hash table of the cell
+// indices, taking memory proportional to the number of data points
+template <typename T>
+void countSparseContingencyTables(
+    const Data& data,
+    const Strata& strata,
+    int a,
+    int b,
+    ContingencyTables& tables
+) {
+    int pointCount = data.pointCount();
+    uint64_t aCatCount = (uint64_t)tables.aCatCount;
+    uint64_t cellCount = aCatCount * (uint64_t)tables.bCatCount;
+
+    vector<pair<uint64_t, uint32_t>>& cells = tables.sparseCells;
+    cells.clear();
+    KeyIndexer indexer(pointCount);
+    vector<T> aBuffer(CountingBlockSize);
+    vector<T> bBuffer(CountingBlockSize);
+    for(int start = 0; start < pointCount; start += CountingBlockSize) {
+        int size = min(CountingBlockSize, pointCount - start);
+        const T* aValues = data.values<T>(a, start, size, aBuffer.data());
+        const T* bValues = data.values<T>(b, start, size, bBuffer.data());
+        const uint32_t* ids = strata.ids.data() + start;
+        for(int i = 0; i < size; ++i) {
+            uint64_t cell = (uint64_t)ids[i] * cellCount + (uint64_t)bValues[i] * aCatCount + (uint64_t)aValues[i];
+            uint32_t idx = indexer.index(cell);
+            if(idx == cells.size()) {
+                cells.emplace_back(cell, 0);
+            }
+            ++cells[idx].second;
+        }
+    }
+    sort(cells.begin(), cells.end());
+}
+
+}
+
+// Computes the strata of the data points by the values of the variables in X.
+// The stratum of a data point is identified by the mixed-radix number formed
+// by its values for X. If the number of such configurations is at most the
+// number of data points, it is used directly as the stratum index (dense
+// path). Otherwise, the occurring configurations are mapped to consecutive
+// indices using a hash table (sparse path). T is the value type of the
+// columns of data.
+template <typename T, int W>
+Strata computeStrata(const Data& data, Bitset<W> X) {
+    using namespace contingency_;
+
+    int pointCount = data.pointCount();
+
+    Strata strata;
+    strata.configCount = 1.0;
+    X.iterate([&](int v) {
+        strata.configCount *= (double)data.catCount(v);
+    });
+
+    if(strata.configCount <= (double)pointCount) {
+        strata.count = (int)strata.configCount;
+        strata.ids.resize(pointCount);
+        if(strata.count <= Strata::NarrowMaxCount) {
+            strata.narrowIds.assign((pointCount + 63) & ~63, 0);
+        }
+
+        vector<pair<int, uint32_t>> columns;
+        uint32_t radix = 1;
+        X.iterate([&](int v) {
+            columns.emplace_back(v, radix);
+            radix *= (uint32_t)data.catCount(v);
+        });
+
+        // Process the data in blocks that stay in the L1 cache
+        const int BlockSize = CountingBlockSize;
+        vector<T> buffer(BlockSize);
+        for(int start = 0; start < pointCount; start += BlockSize) {
+            int blockSize = min(BlockSize, pointCount - start);
+            uint32_t* ids = strata.ids.data() + start;
+            fill(ids, ids + blockSize, 0);
+            for(pair<int, uint32_t> column : columns) {
+                const T* values = data.values<T>(column.first, start, blockSize, buffer.data());
+                uint32_t multiplier = column.second;
+                for(int i = 0; i < blockSize; ++i) {
+                    ids[i] += (uint32_t)values[i] * multiplier;
+                }
+            }
+            if(!strata.narrowIds.empty()) {
+                uint8_t* narrowIds = strata.narrowIds.data() + start;
+                for(int i = 0; i < blockSize; ++i) {
+                    narrowIds[i] = (uint8_t)ids[i];
+                }
+            }
+        }
+    } else {
+        vector<uint64_t> keys(pointCount, 0);
+        uint64_t radix = 1;
+        X.iterate([&](int v) {
+            uint64_t catCount = (uint64_t)data.catCount(v);
+            if(radix > numeric_limits<uint64_t>::max() / catCount) {
+                // The keys would overflow; renumber the occurring ones
+                radix = compactKeys(keys);
+            }
+            vector<T> buffer(CountingBlockSize);
+            for(int start = 0; start < pointCount; start += CountingBlockSize) {
+                int blockSize = min(CountingBlockSize, pointCount - start);
+                const T* values = data.values<T>(v, start, blockSize, buffer.data());
+                uint64_t* blockKeys = keys.data() + start;
+                for(int i = 0; i < blockSize; ++i) {
+                    blockKeys[i] += (uint64_t)values[i] * radix;
+                }
+            }
+            radix *= catCount;
+        });
+        strata.count = (int)compactKeys(keys);
+        strata.ids.resize(pointCount);
+        for(int i = 0; i < pointCount; ++i) {
+            strata.ids[i] = (uint32_t)keys[i];
+        }
+    }
+
+    return strata;
+}
+
+// Counts the contingency tables of a and b in the given strata in one pass
+// over the data, using the fastest counting kernel supported by the CPU. T is
+// the value type of the columns of data. Bit-packed columns are decoded block
+// by block, except that binary pairs are counted directly from the packed
+// words.
+template <typename T>
+void countContingencyTables(
+    const Data& data,
+    const Strata& strata,
+    int a,
+    int b,
+    ContingencyTables& tables
+) {
+    using namespace contingency_;
+
+    int aCatCount = data.catCount(a);
+    int bCatCount = data.catCount(b);
+    int pointCount = data.pointCount();
+
+    tables.aCatCount = aCatCount;
+    tables.bCatCount = bCatCount;
+    tables.stratumCount = strata.count;
+    tables.sparse = useSparseTables(pointCount, strata.count, aCatCount, bCatCount);
+    if(tables.sparse) {
+        tables.counts.clear();
+        countSparseContingencyTables<T>(data, strata, a, b, tables);
+        return;
+    }
+    CHECK((double)strata.count * aCatCount * bCatCount <= (double)INT32_MAX);
+    tables.counts.assign((size_t)strata.count * aCatCount * bCatCount, 0);
+    uint32_t* counts = tables.counts.data();
+
+    if(tryCountCellsPackedBinary(data, strata, a, b, counts)) {
+        return;
+    }
+
+    // Unpacked columns are counted in one block
+    int blockSize = data.isPacked() ? CountingBlockSize : max(pointCount, 1);
+    vector<T> aBuffer, bBuffer;
+    if(data.isPacked()) {
+        aBuffer.resize(blockSize);
+        bBuffer.resize(blockSize);
+    }
+
+    uint32_t cellCount = (uint32_t)(aCatCount * bCatCount);
+    for(int start = 0; start < pointCount; start += blockSize) {
+        int size = min(blockSize, pointCount - start);
+        const T* aValues = data.values<T>(a, start, size, aBuffer.data());
+        const T* bValues = data.values<T>(b, start, size, bBuffer.data());
+        const uint8_t* narrowIds = strata.narrowIds.empty() ? nullptr : strata.narrowIds.data() + start;
+        if(tryCountCellsBitmap(
+            narrowIds, strata.count, aValues, bValues, size, aCatCount, bCatCount, counts
+        )) {
+            continue;
+        }
+
+        const uint32_t* ids = strata.ids.data() + start;
+        if(simdLevel() == SimdLevel::AVX512) {
+            countCellsAVX512(ids, aValues, bValues, size, aCatCount, cellCount, counts);
+        } else {
+            countCellsScalar(ids, aValues, bValues, size, aCatCount, cellCount, counts);
+        }
+    }
+}
+
+// Calls f(counts, aCounts, bCounts, total) for each nonempty stratum of
+// tables, where counts points to the contingency table of the stratum,
+// aCounts and bCounts are its marginal counts of a and b and total is its
+// number of data points
+template <typename F>
+void iterateStrata(const ContingencyTables& tables, F f) {
+    int aCatCount = tables.aCatCount;
+    int bCatCount = tables.bCatCount;
+    int cellCount = aCatCount * bCatCount;
+    vector<uint32_t> aCounts(aCatCount);
+    vector<uint32_t> bCounts(bCatCount);
+
+    auto visit = [&](const uint32_t* counts) {
+        fill(aCounts.begin(), aCounts.end(), 0);
+        fill(bCounts.begin(), bCounts.end(), 0);
+        uint32_t total = 0;
+        for(int bVal = 0; bVal < bCatCount; ++bVal) {
+            for(int aVal = 0; aVal < aCatCount; ++aVal) {
+                uint32_t count = counts[bVal * aCatCount + aVal];
+                aCounts[aVal] += count;
+                bCounts[bVal] += count;
+                total += count;
+            }
+        }
+        if(total != 0) {
+            f(counts, (const uint32_t*)aCounts.data(), (const uint32_t*)bCounts.data(), total);
+        }
+    };
+
+    if(!tables.sparse) {
+        for(int s = 0; s < tables.stratumCount; ++s) {
+            visit(tables.counts.data() + (size_t)s * cellCount);
+        }
+        return;
+    }
+
+    // The cells of each stratum are consecutive in sparseCells; they are
+    // expanded to a dense table that is cleared again afterwards
+    const vector<pair<uint64_t, uint32_t>>& cells = tables.sparseCells;
+    vector<uint32_t> counts(cellCount, 0);
+    size_t begin = 0;
+    while(begin < cells.size()) {
+        uint64_t stratum = cells[begin].first / (uint64_t)cellCount;
+        size_t end = begin;
+        while(end < cells.size() && cells[end].first / (uint64_t)cellCount == stratum) {
+            counts[cells[end].first % (uint64_t)cellCount] = cells[end].second;
+            ++end;
+        }
+        visit(counts.data());
+        for(size_t i = begin; i < end; ++i) {
+            counts[cells[i].first % (uint64_t)cellCount] = 0;
+        }
+        begin = end;
+    }
+}
+
+// The degrees of freedom of the chi-squared distribution of the test
+// statistics of tables in the strata of X; configCount is the number of
+// configurations of X
+inline double contingencyFreedom(const ContingencyTables& tables, double configCount) {
+    return configCount * ((double)tables.aCatCount - 1.0) * ((double)tables.bCatCount - 1.0);
+}
+
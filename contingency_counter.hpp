@@ -0,0 +1,182 @@
+#pragma once
+
+#include "bitmap_index.hpp"
+#include "contingency.hpp"
+#include "table_cache.hpp"
+
+// Counts the contingency tables for the independence tests on a data set.
+// The tables are counted using an optional bitmap index of the data, and
+// optionally memoized in a joint table cache, from which the tables of
+// subsets of cached variable sets are obtained by marginalization. All the
+// methods can be called from multiple threads concurrently.
+template <int W>
+class ContingencyCounter {
+public:
+    struct Stats {
+        // The number of tables found in the cache
+        uint64_t hitCount;
+
+        // The number of tables marginalized from a cached superset table
+        uint64_t supersetHitCount;
+
+        // The number of tables counted from the data or the bitmap index
+        uint64_t missCount;
+
+        uint64_t evictionCount;
+        size_t memoryUsage;
+    };
+
+    // If bitmapIndex is given, it must be an index of data. The joint table
+    // cache is used if tableCacheMemoryCap is nonzero. Both data and
+    // bitmapIndex must outlive the counter.
+    ContingencyCounter(
+        const Data& data,
+        const BitmapIndex* bitmapIndex = nullptr,
+        size_t tableCacheMemoryCap = 0
+    )
+        : data_(data),
+          bitmapIndex_(bitmapIndex),
+          hitCount_(0),
+          supersetHitCount_(0),
+          missCount_(0)
+    {
+        CHECK(data.varCount() <= Bitset<W>::BitCount);
+        CHECK(data.pointCount() > 0);
+        CHECK(!bitmapIndex || bitmapIndex->pointCount() == data.pointCount());
+        if(tableCacheMemoryCap) {
+            cache_.reset(new JointTableCache<W>(tableCacheMemoryCap));
+        }
+    }
+
+    ContingencyCounter(const ContingencyCounter&) = delete;
+    ContingencyCounter(ContingencyCounter&&) = delete;
+    ContingencyCounter& operator=(const ContingencyCounter&) = delete;
+    ContingencyCounter& operator=(ContingencyCounter&&) = delete;
+
+    const Data& data() const {
+        return data_;
+    }
+
+    // Calls f(i, tables) with the contingency tables of pairs[i] in the strata
+    // of X for each i. The strata are numbered in mixed-radix order of X if
+    // there are at most as many configurations of X as data points, and
+    // arbitrarily otherwise.
+    template <typename F>
+    void count(Bitset<W> X, const vector<pair<int, int>>& pairs, F f) {
+        CHECK(X.isSubsetOf(Bitset<W>::range(data_.varCount())));
+        for(pair<int, int> p : pairs) {
+            int a = p.first;
+            int b = p.second;
+            CHECK(a >= 0 && a < data_.varCount());
+            CHECK(b >= 0 && b < data_.varCount());
+            CHECK(a != b);
+            CHECK(!X.contains(a));
+            CHECK(!X.contains(b));
+        }
+
+        dispatchDataValueType(data_, [&](auto t) {
+            typedef decltype(t) T;
+
+            // The strata are computed only if some pair has to be counted
+            // from the data
+            Strata strata;
+            bool strataComputed = false;
+
+            ContingencyTables tables;
+            for(int i = 0; i < (int)pairs.size(); ++i) {
+                int a = pairs[i].first;
+                int b = pairs[i].second;
+                Bitset<W> V = X.with(a).with(b);
+
+                shared_ptr<const JointTable> cached;
+                if(cache_) {
+                    cached = cache_->find(V);
+                }
+                if(cached) {
+                    hitCount_.fetch_add(1, memory_order_relaxed);
+                    marginalizeJointTable(*cached, data_.catCounts(), X, a, b, tables);
+                } else if(bitmapIndex_ && bitmapIndex_->coversQuery(X, a, b)) {
+                    missCount_.fetch_add(1, memory_order_relaxed);
+                    bitmapIndex_->countContingencyTables(X, a, b, tables);
+                    insert_(V, X, a, b, tables);
+                } else if(findSuperset_(V, cached)) {
+                    supersetHitCount_.fetch_add(1, memory_order_relaxed);
+                    marginalizeJointTable(*cached, data_.catCounts(), X, a, b, tables);
+                    insert_(V, X, a, b, tables);
+                } else {
+                    missCount_.fetch_add(1, memory_order_relaxed);
+                    if(!strataComputed) {
+                        strata = computeStrata<T>(data_, X);
+                        strataComputed = true;
+                    }
+                    countContingencyTables<T>(data_, strata, a, b, tables);
+                    if(strata.count == strata.configCount) {
+                        insert_(V, X, a, b, tables);
+                    }
+                }
+                f(i, (const ContingencyTables&)tables);
+            }
+        });
+    }
+
+    Stats stats() const {
+        Stats ret;
+        ret.hitCount = hitCount_.load(memory_order_relaxed);
+        ret.supersetHitCount = supersetHitCount_.load(memory_order_relaxed);
+        ret.missCount = missCount_.load(memory_order_relaxed);
+        ret.evictionCount = cache_ ? cache_->evictionCount() : 0;
+        ret.memoryUsage = cache_ ? cache_->memoryUsage() : 0;
+        return ret;
+    }
+
+private:
+    const Data& data_;
+    const BitmapIndex* bitmapIndex_;
+    unique_ptr<JointTableCache<W>> cache_;
+
+    atomic<uint64_t> hitCount_;
+    atomic<uint64_t> supersetHitCount_;
+    atomic<uint64_t> missCount_;
+
+    // Looks for a cached table of V extended by one variable. Only tables that
+    // are smaller than the data are searched for, as marginalizing a larger
+    // one is slower than counting from the data.
+    bool findSuperset_(Bitset<W> V, shared_ptr<const JointTable>& table) {
+        if(!cache_) {
+            return false;
+        }
+        double cellCount = 1.0;
+        V.iterate([&](int v) {
+            cellCount *= (double)data_.catCount(v);
+        });
+        for(int v = 0; v < data_.varCount(); ++v) {
+            if(
+                !V.contains(v) &&
+                cellCount * (double)data_.catCount(v) <= (double)data_.pointCount()
+            ) {
+                table = cache_->find(V.with(v));
+                if(table) {
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    // Adds the tables of a and b in the strata of X to the cache as the joint
+    // table of V if they are dense and smaller than the data
+    void insert_(Bitset<W> V, Bitset<W> X, int a, int b, const ContingencyTables& tables) {
+        if(!cache_ || tables.sparse || tables.counts.size() > (size_t)data_.pointCount()) {
+            return;
+        }
+        shared_ptr<JointTable> table = make_shared<JointTable>();
+        table->vars.push_back(a);
+        table->vars.push_back(b);
+        X.iterate([&](int v) {
+            table->vars.push_back(v);
+        });
+        table->counts = tables.counts;
+        size_t size = jointTableSize(*table);
+        cache_->insert(V, move(table), size);
+    }
+};
@@ -0,0 +1,133 @@
+#include "contingency.hpp"
+
+mt19937 rng(random_device{}());
+
+int randInt(int a, int b) {
+    return uniform_int_distribution<int>(a, b)(rng);
+}
+
+// Point counts around the block boundaries of the counting kernels
+int randomPointCount() {
+    const int boundaries[] = {64, 2048, 4096};
+    if(randInt(0, 3) == 0) {
+        return randInt(1, 5000);
+    }
+    return max(boundaries[randInt(0, 2)] + randInt(-2, 2), 1);
+}
+
+// Counts the contingency tables of a and b in the strata of X directly from
+// the unpacked columns
+template <typename T>
+vector<uint32_t> countNaive(const Data& data, const Strata& strata, int a, int b) {
+    int aCatCount = data.catCount(a);
+    int bCatCount = data.catCount(b);
+    vector<uint32_t> counts((size_t)strata.count * aCatCount * bCatCount, 0);
+    for(int i = 0; i < data.pointCount(); ++i) {
+        T aVal = data.column<T>(a)[i];
+        T bVal = data.column<T>(b)[i];
+        ++counts[((size_t)strata.ids[i] * bCatCount + bVal) * aCatCount + aVal];
+    }
+    return counts;
+}
+
+// The dense form of tables
+vector<uint32_t> denseCounts(const ContingencyTables& tables) {
+    if(!tables.sparse) {
+        return tables.counts;
+    }
+    vector<uint32_t> counts((size_t)tables.stratumCount * tables.aCatCount * tables.bCatCount, 0);
+    for(pair<uint64_t, uint32_t> cell : tables.sparseCells) {
+        counts[cell.first] = cell.second;
+    }
+    return counts;
+}
+
+// Checks that the contingency tables of a and b in the strata of X counted
+// from packed and unpacked data match the direct count
+void runTest(vector<int> catCounts, int pointCount, int a, int b, Bitset<1> X) {
+    int varCount = (int)catCounts.size();
+    Data data(catCounts, pointCount);
+    for(int v = 0; v < varCount; ++v) {
+        uint8_t* column = data.column<uint8_t>(v);
+        for(int i = 0; i < pointCount; ++i) {
+            column[i] = (uint8_t)randInt(0, catCounts[v] - 1);
+        }
+    }
+    Data packed = data.pack();
+
+    ScopedFailureContextPrint scopedFailureContextPrint(
+        [&](std::ostream& out) {
+            out << "Point count: " << pointCount << '\n';
+            out << "Category counts:";
+            for(int catCount : catCounts) {
+                out << ' ' << catCount;
+            }
+            out << '\n';
+            out << "a = " << a << ", b = " << b << ", X =";
+            X.iterate([&](int v) {
+                out << ' ' << v;
+            });
+            out << '\n';
+        }
+    );
+
+    Strata strata = computeStrata<uint8_t>(data, X);
+    Strata packedStrata = computeStrata<uint8_t>(packed, X);
+    CHECK(strata.count == packedStrata.count);
+    CHECK(strata.ids == packedStrata.ids);
+    CHECK(strata.narrowIds == packedStrata.narrowIds);
+
+    ContingencyTables tables;
+    ContingencyTables packedTables;
+    countContingencyTables<uint8_t>(data, strata, a, b, tables);
+    countContingencyTables<uint8_t>(packed, packedStrata, a, b, packedTables);
+    vector<uint32_t> naive = countNaive<uint8_t>(data, strata, a, b);
+    CHECK(denseCounts(tables) == naive);
+    CHECK(denseCounts(packedTables) == naive);
+}
+
+void runRandomTest() {
+    int varCount = randInt(2, 6);
+    vector<int> catCounts(varCount);
+    for(int v = 0; v < varCount; ++v) {
+        // One and two categories are the special cases of the packed kernels
+        catCounts[v] = randInt(0, 1) ? randInt(1, 2) : randInt(1, 17);
+    }
+
+    int a = randInt(0, varCount - 1);
+    int b = randInt(0, varCount - 2);
+    if(b >= a) {
+        ++b;
+    }
+    Bitset<1> X = Bitset<1>::empty();
+    for(int v = 0; v < varCount; ++v) {
+        if(v != a && v != b && randInt(0, 1)) {
+            X.add(v);
+        }
+    }
+
+    runTest(move(catCounts), randomPointCount(), a, b, X);
+}
+
+int main(int argc, char* argv[]) {
+    if(argc != 2) {
+        cerr << "Usage: ./contingency_test <test count>\n";
+        CHECK(false);
+    }
+
+    int testCount = parseString<int>(argv[1]);
+    CHECK(testCount >= 0);
+
+    // A variable of one category is packed at one bit per value like binary
+    // variables, but must not be counted with the binary kernel
+    Bitset<1> X = Bitset<1>::empty();
+    X.add(2);
+    runTest({1, 2, 2}, 4096, 0, 1, X);
+
+    for(int i = 0; i < testCount; ++i) {
+        runRandomTest();
+    }
+    cout << "OK: " << testCount << " tests\n";
+
+    return 0;
+}
@@ -0,0 +1,17 @@
+#include "file.hpp"
+
+int main(int argc, char* argv[]) {
+    if(argc != 1) {
+        cerr << "Usage: ./convert_data < <text data file> > <binary data file>\n";
+        CHECK(false);
+    }
+
+    // The calling thread parses a part of the data as well
+    ThreadPool pool(max((int)thread::hardware_concurrency() - 1, 0));
+    Data data = readData(cin, &pool);
+    writeBinaryData(data, cout);
+    cout.flush();
+    CHECK(cout.good());
+
+    return 0;
+}
@@ -3,13 +3,14 @@
 #include "digraph.hpp"
 #include "graph.hpp"
 
-inline Digraph constructCPDAG(
-    const Graph& skeleton,
-    const vector<pair<pair<int, int>, Bitset>>& edgeSeparators
+template <int W>
+Digraph<W> constructCPDAG(
+    const Graph<W>& skeleton,
+    const vector<pair<pair<int, int>, Bitset<W>>>& edgeSeparators
 ) {
-    Digraph cpdag(skeleton.vertCount());
+    Digraph<W> cpdag(skeleton.vertCount());
     for(int b = 0; b < cpdag.vertCount(); ++b) {
-        skeleton.adjacentVerts(b).intersectWith(Bitset::range(b)).iterate([&](int a) {
+        skeleton.adjacentVerts(b).intersectWith(Bitset<W>::range(b)).iterate([&](int a) {
             cpdag.addEdge(a, b);
             cpdag.addEdge(b, a);
         });
@@ -18,7 +19,7 @@ inline Digraph constructCPDAG(
     for(const auto& edgeSeparator : edgeSeparators) {
         int a = edgeSeparator.first.first;
         int b = edgeSeparator.first.second;
-        Bitset X = edgeSeparator.second;
+        Bitset<W> X = edgeSeparator.second;
         skeleton.adjacentVerts(a)
             .intersectWith(skeleton.adjacentVerts(b))
             .minus(X)
@@ -2,7 +2,401 @@
 
 #include "common.hpp"
 
-struct Data {
-    vector<int> catCounts;
-    vector<vector<int>> points;
+namespace data_ {
+
+// The number of bits per value of a bit-packed column: the smallest power of
+// two that fits the categories, so that no value straddles two words
+inline int packedBits(int catCount) {
+    int bits = 1;
+    while((1 << bits) < catCount) {
+        bits *= 2;
+    }
+    return bits;
+}
+
+// Decodes wordCount words of values packed at B bits per value to out
+template <int B, typename T>
+void decodePackedWords(const uint64_t* words, int wordCount, T* out) {
+    constexpr int K = 64 / B;
+    constexpr uint64_t Mask = ((uint64_t)1 << B) - 1;
+    for(int w = 0; w < wordCount; ++w) {
+        uint64_t word = words[w];
+        for(int j = 0; j < K; ++j) {
+            out[j] = (T)((word >> (j * B)) & Mask);
+        }
+        out += K;
+    }
+}
+
+// Binary values of bytes: each bit of a word expands to a byte by masking
+__attribute__((target("avx512f,avx512bw")))
+inline void decodePackedBitsAVX512(const uint64_t* words, int wordCount, uint8_t* out) {
+    for(int w = 0; w < wordCount; ++w) {
+        _mm512_storeu_si512(out + 64 * w, _mm512_maskz_set1_epi8(words[w], 1));
+    }
+}
+__attribute__((target("avx2")))
+inline void decodePackedBitsAVX2(const uint64_t* words, int wordCount, uint8_t* out) {
+    // Byte j of the result takes bit j % 8 of byte j / 8 of the 32-bit half
+    const __m256i shuffle = _mm256_setr_epi8(
+        0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1,
+        2, 2, 2, 2, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 3, 3
+    );
+    const __m256i bitSelect = _mm256_set1_epi64x((long long)0x8040201008040201);
+    const __m256i one = _mm256_set1_epi8(1);
+    for(int w = 0; w < wordCount; ++w) {
+        for(int h = 0; h < 2; ++h) {
+            __m256i bytes = _mm256_shuffle_epi8(
+                _mm256_set1_epi32((int)(uint32_t)(words[w] >> (32 * h))), shuffle
+            );
+            bytes = _mm256_min_epu8(_mm256_and_si256(bytes, bitSelect), one);
+            _mm256_storeu_si256((__m256i*)(out + 64 * w + 32 * h), bytes);
+        }
+    }
+}
+
+inline void decodePacked(const uint64_t* words, int bits, int wordCount, uint8_t* out) {
+    switch(bits) {
+    case 1:
+        if(simdLevel() == SimdLevel::AVX512) {
+            decodePackedBitsAVX512(words, wordCount, out);
+        } else if(simdLevel() == SimdLevel::AVX2) {
+            decodePackedBitsAVX2(words, wordCount, out);
+        } else {
+            decodePackedWords<1>(words, wordCount, out);
+        }
+        break;
+    case 2:
+        decodePackedWords<2>(words, wordCount, out);
+        break;
+    case 4:
+        decodePackedWords<4>(words, wordCount, out);
+        break;
+    case 8:
+        decodePackedWords<8>(words, wordCount, out);
+        break;
+    default:
+        CHECK(false);
+    }
+}
+inline void decodePacked(const uint64_t* words, int bits, int wordCount, uint16_t* out) {
+    switch(bits) {
+    case 1:
+        decodePackedWords<1>(words, wordCount, out);
+        break;
+    case 2:
+        decodePackedWords<2>(words, wordCount, out);
+        break;
+    case 4:
+        decodePackedWords<4>(words, wordCount, out);
+        break;
+    case 8:
+        decodePackedWords<8>(words, wordCount, out);
+        break;
+    case 16:
+        decodePackedWords<16>(words, wordCount, out);
+        break;
+    default:
+        CHECK(false);
+    }
+}
+
+}
+
+// Discrete data set stored by columns: column<T>(v)[i] is the category of
+// variable v in data point i. The values are stored as uint8_t, or as
+// uint16_t for all the columns if some variable has more than 256 categories.
+// Each column is contiguous and aligned to 64 bytes. Copies of the object
+// share the same storage.
+//
+// Alternatively, the columns may be bit-packed (see pack), in which case
+// column is not available and the values are read in blocks using values,
+// which decodes them to T.
+class Data {
+public:
+    static constexpr int MaxCatCount = 65536;
+
+    Data() : pointCount_(0), wide_(false), columnStride_(0) {}
+
+    // Allocates zero-initialized storage for pointCount data points of
+    // variables with given category counts
+    Data(vector<int> catCounts, int pointCount)
+        : catCounts_(move(catCounts)),
+          pointCount_(pointCount)
+    {
+        initLayout_();
+        size_t size = storageSize();
+
+        void* storage;
+        CHECK(!posix_memalign(&storage, 64, size));
+        memset(storage, 0, size);
+        storage_ = shared_ptr<uint8_t>((uint8_t*)storage, [](uint8_t* p) { free(p); });
+    }
+
+    // Uses existing storage of storageSize() bytes aligned to 64 bytes, such
+    // as a memory-mapped file, containing the columns one after another, each
+    // taking columnStride() bytes and padded with zeros
+    Data(vector<int> catCounts, int pointCount, shared_ptr<uint8_t> storage)
+        : catCounts_(move(catCounts)),
+          pointCount_(pointCount),
+          storage_(move(storage))
+    {
+        initLayout_();
+        CHECK(!((uintptr_t)storage_.get() & (uintptr_t)63));
+    }
+
+    int varCount() const {
+        return (int)catCounts_.size();
+    }
+    int pointCount() const {
+        return pointCount_;
+    }
+    const vector<int>& catCounts() const {
+        return catCounts_;
+    }
+    int catCount(int v) const {
+        return catCounts_[v];
+    }
+
+    // True if the values are stored as uint16_t instead of uint8_t
+    bool wide() const {
+        return wide_;
+    }
+
+    // The distance between the starts of consecutive columns in bytes, a
+    // multiple of 64; only for unpacked data
+    size_t columnStride() const {
+        CHECK(!isPacked());
+        return columnStride_;
+    }
+    size_t storageSize() const {
+        CHECK(!isPacked());
+        return max(columnStride_ * catCounts_.size(), (size_t)64);
+    }
+
+    bool isPacked() const {
+        return !packedOffsets_.empty();
+    }
+
+    // Returns a copy of the data with each column bit-packed to packedBits(v)
+    // bits per value
+    Data pack() const {
+        CHECK(!isPacked());
+
+        Data ret = *this;
+        ret.packedOffsets_.resize(varCount() + 1);
+        size_t wordTotal = 0;
+        for(int v = 0; v < varCount(); ++v) {
+            ret.packedOffsets_[v] = wordTotal;
+            wordTotal += packedWordCount_(data_::packedBits(catCount(v)));
+        }
+        ret.packedOffsets_[varCount()] = wordTotal;
+
+        size_t size = max(wordTotal * sizeof(uint64_t), (size_t)64);
+        void* storage;
+        CHECK(!posix_memalign(&storage, 64, size));
+        memset(storage, 0, size);
+        ret.storage_ = shared_ptr<uint8_t>((uint8_t*)storage, [](uint8_t* p) { free(p); });
+
+        dispatchValueType_([&](auto t) {
+            typedef decltype(t) T;
+            for(int v = 0; v < varCount(); ++v) {
+                const T* column = this->column<T>(v);
+                uint64_t* words = ret.packedColumn_(v);
+                int bits = data_::packedBits(catCount(v));
+                int perWord = 64 / bits;
+                for(int i = 0; i < pointCount_; ++i) {
+                    words[i / perWord] |= (uint64_t)column[i] << (i % perWord * bits);
+                }
+            }
+        });
+        return ret;
+    }
+
+    // The number of bits per value of variable v in bit-packed data
+    int packedBits(int v) const {
+        CHECK(isPacked());
+        CHECK(v >= 0 && v < varCount());
+        return data_::packedBits(catCounts_[v]);
+    }
+
+    // The packed words of variable v: the value of data point i is in bits
+    // [j * b, (j + 1) * b) of word i / (64 / b), where j = i % (64 / b) and
+    // b = packedBits(v). The words are aligned to 64 bytes and padded with
+    // zeros to a multiple of 8 words.
+    const uint64_t* packedColumn(int v) const {
+        CHECK(isPacked());
+        CHECK(v >= 0 && v < varCount());
+        return (const uint64_t*)storage_.get() + packedOffsets_[v];
+    }
+
+    // The memory used by the values in bytes
+    size_t memoryUsage() const {
+        return isPacked() ? packedOffsets_.back() * sizeof(uint64_t) : storageSize();
+    }
+
+    // Returns the values of variable v for the data points start, ...,
+    // start + count - 1, where start is a multiple of 64. The values past
+    // pointCount() up to the next multiple of 64 data points are zero. For
+    // unpacked data, returns a pointer to the column; for packed data,
+    // decodes the values to buffer, which must have room for count rounded
+    // up to a multiple of 64 values, and returns buffer.
+    template <typename T>
+    const T* values(int v, int start, int count, T* buffer) const {
+        CHECK(start % 64 == 0 && start >= 0 && count >= 0 && start + count <= pointCount_);
+        if(!isPacked()) {
+            return column<T>(v) + start;
+        }
+        CHECK((is_same<T, uint16_t>::value) == wide_);
+        int bits = packedBits(v);
+        int perWord = 64 / bits;
+        data_::decodePacked(
+            packedColumn(v) + start / perWord, bits, ((count + 63) & ~63) / perWord, buffer
+        );
+        return buffer;
+    }
+
+    // T must be uint16_t if wide() is true and uint8_t otherwise
+    template <typename T>
+    const T* column(int v) const {
+        checkColumn_<T>(v);
+        return (const T*)(storage_.get() + (size_t)v * columnStride_);
+    }
+    template <typename T>
+    T* column(int v) {
+        checkColumn_<T>(v);
+        return (T*)(storage_.get() + (size_t)v * columnStride_);
+    }
+
+private:
+    vector<int> catCounts_;
+    int pointCount_;
+    bool wide_;
+    size_t columnStride_;
+    shared_ptr<uint8_t> storage_;
+
+    // If the data is packed, the start of the packed column of each variable
+    // in words followed by the total word count. Empty otherwise.
+    vector<size_t> packedOffsets_;
+
+    size_t packedWordCount_(int bits) const {
+        // Whole blocks of 64 values, as decoded by values
+        size_t wordCount = ((size_t)pointCount_ + 63) / 64 * bits;
+        return (wordCount + 7) & ~(size_t)7;
+    }
+
+    uint64_t* packedColumn_(int v) {
+        return (uint64_t*)storage_.get() + packedOffsets_[v];
+    }
+
+    template <typename F>
+    void dispatchValueType_(F f) const {
+        if(wide_) {
+            f(uint16_t());
+        } else {
+            f(uint8_t());
+        }
+    }
+
+    void initLayout_() {
+        CHECK(pointCount_ >= 0);
+        wide_ = false;
+        for(int catCount : catCounts_) {
+            CHECK(catCount >= 1 && catCount <= MaxCatCount);
+            if(catCount > 256) {
+                wide_ = true;
+            }
+        }
+
+        size_t valueSize = wide_ ? sizeof(uint16_t) : sizeof(uint8_t);
+        columnStride_ = ((size_t)pointCount_ * valueSize + (size_t)63) & ~(size_t)63;
+    }
+
+    template <typename T>
+    void checkColumn_(int v) const {
+        static_assert(
+            is_same<T, uint8_t>::value || is_same<T, uint16_t>::value,
+            "Data columns are stored as uint8_t or uint16_t"
+        );
+        CHECK(v >= 0 && v < varCount());
+        CHECK((is_same<T, uint16_t>::value) == wide_);
+        CHECK(!isPacked());
+    }
+};
+
+// Calls f(T()) where T is the value type of the columns of data
+template <typename F>
+auto dispatchDataValueType(const Data& data, F f) -> decltype(f(uint8_t())) {
+    if(data.wide()) {
+        return f(uint16_t());
+    } else {
+        return f(uint8_t());
+    }
+}
+
+// Returns the data points of data with given indices in the given order, as
+// packed data if data is packed
+inline Data selectDataPoints(const Data& data, const vector<int>& points) {
+    Data ret(data.catCounts(), (int)points.size());
+    dispatchDataValueType(data, [&](auto t) {
+        typedef decltype(t) T;
+        vector<T> column(((size_t)data.pointCount() + 63) & ~(size_t)63);
+        for(int v = 0; v < data.varCount(); ++v) {
+            const T* values = data.values<T>(v, 0, data.pointCount(), column.data());
+            T* dst = ret.column<T>(v);
+            for(int i = 0; i < (int)points.size(); ++i) {
+                CHECK(points[i] >= 0 && points[i] < data.pointCount());
+                dst[i] = values[points[i]];
+            }
+        }
+    });
+    return data.isPacked() ? ret.pack() : ret;
+}
+
+// Continuous data set stored by columns: column(v)[i] is the value of variable
+// v in data point i. Each column is contiguous and aligned to 64 bytes. Copies
+// of the object share the same storage.
+class ContinuousData {
+public:
+    ContinuousData() : varCount_(0), pointCount_(0), columnStride_(0) {}
+
+    // Allocates zero-initialized storage for pointCount data points of
+    // varCount variables
+    ContinuousData(int varCount, int pointCount)
+        : varCount_(varCount),
+          pointCount_(pointCount)
+    {
+        CHECK(varCount_ >= 0);
+        CHECK(pointCount_ >= 0);
+
+        columnStride_ = ((size_t)pointCount_ * sizeof(double) + (size_t)63) & ~(size_t)63;
+        size_t storageSize = max(columnStride_ * (size_t)varCount_, (size_t)64);
+
+        void* storage;
+        CHECK(!posix_memalign(&storage, 64, storageSize));
+        memset(storage, 0, storageSize);
+        storage_ = shared_ptr<uint8_t>((uint8_t*)storage, [](uint8_t* p) { free(p); });
+    }
+
+    int varCount() const {
+        return varCount_;
+    }
+    int pointCount() const {
+        return pointCount_;
+    }
+
+    const double* column(int v) const {
+        CHECK(v >= 0 && v < varCount_);
+        return (const double*)(storage_.get() + (size_t)v * columnStride_);
+    }
+    double* column(int v) {
+        CHECK(v >= 0 && v < varCount_);
+        return (double*)(storage_.get() + (size_t)v * columnStride_);
+    }
+
+private:
+    int varCount_;
+    int pointCount_;
+    size_t columnStride_;
+    shared_ptr<uint8_t> storage_;
 };
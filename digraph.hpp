@@ -2,42 +2,44 @@
 
 #include "bitset.hpp"
 
+template <int W>
 class Digraph {
 public:
-    static constexpr int MaxVertCount = Bitset::BitCount;
-    static_assert(MaxVertCount <= Bitset::BitCount);
+    static constexpr int MaxVertCount = Bitset<W>::BitCount;
 
     Digraph() : Digraph(0) {}
-    Digraph(int vertCount) : vertCount_(vertCount) {
+    Digraph(int vertCount)
+        : vertCount_(vertCount),
+          edgesIn_(vertCount, Bitset<W>::empty()),
+          edgesOut_(vertCount, Bitset<W>::empty())
+    {
         CHECK(vertCount >= 0 && vertCount <= MaxVertCount);
-        fill(edgesIn_, edgesIn_ + vertCount_, Bitset::empty());
-        fill(edgesOut_, edgesOut_ + vertCount_, Bitset::empty());
     }
 
     int vertCount() const {
         return vertCount_;
     }
-    Bitset edgesIn(int v) const {
+    Bitset<W> edgesIn(int v) const {
         CHECK(v >= 0 && v < vertCount_);
         return edgesIn_[v];
     }
-    Bitset edgesOut(int v) const {
+    Bitset<W> edgesOut(int v) const {
         CHECK(v >= 0 && v < vertCount_);
         return edgesOut_[v];
     }
-    Bitset edgesOnlyIn(int v) const {
+    Bitset<W> edgesOnlyIn(int v) const {
         CHECK(v >= 0 && v < vertCount_);
         return edgesIn_[v].minus(edgesOut_[v]);
     }
-    Bitset edgesOnlyOut(int v) const {
+    Bitset<W> edgesOnlyOut(int v) const {
         CHECK(v >= 0 && v < vertCount_);
         return edgesOut_[v].minus(edgesIn_[v]);
     }
-    Bitset neighbors(int v) const {
+    Bitset<W> neighbors(int v) const {
         CHECK(v >= 0 && v < vertCount_);
         return edgesIn_[v].unionWith(edgesOut_[v]);
     }
-    Bitset bidirNeighbors(int v) const {
+    Bitset<W> bidirNeighbors(int v) const {
         CHECK(v >= 0 && v < vertCount_);
         return edgesIn_[v].intersectWith(edgesOut_[v]);
     }
@@ -87,6 +89,6 @@ public:
 
 private:
     int vertCount_;
-    Bitset edgesIn_[MaxVertCount];
-    Bitset edgesOut_[MaxVertCount];
+    vector<Bitset<W>> edgesIn_;
+    vector<Bitset<W>> edgesOut_;
 };
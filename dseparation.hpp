@@ -2,69 +2,218 @@
 
 #include "digraph.hpp"
 
-// Returns true if a is d-separated from b given X
-bool isDSeparated(const Digraph& dag, int a, Bitset X, int b) {
-    if(dag.neighbors(a).contains(b)) {
-        return false;
-    }
+namespace dseparation_ {
 
-    Bitset ancestorsX = Bitset::empty();
-    Bitset ancestorQueueX = X;
-    while(!ancestorQueueX.isEmpty()) {
-        int v = ancestorQueueX.min();
-        ancestorQueueX.del(v);
-        ancestorsX.add(v);
-        ancestorQueueX = ancestorQueueX.unionWith(dag.edgesIn(v)).minus(ancestorsX);
+// Returns the set of vertices of X and the vertices reachable from them
+// through edges(v), which is either the parents or the children of v
+template <int W, typename F>
+Bitset<W> closureWithSelf(Bitset<W> X, F edges) {
+    Bitset<W> ret = X;
+    Bitset<W> frontier = X;
+    while(!frontier.isEmpty()) {
+        Bitset<W> next = Bitset<W>::empty();
+        frontier.iterate([&](int v) {
+            next = next.unionWith(edges(v));
+        });
+        frontier = next.minus(ret);
+        ret = ret.unionWith(frontier);
     }
+    return ret;
+}
 
-    Bitset seenAdvs[Digraph::MaxVertCount];
-    fill(seenAdvs, seenAdvs + dag.vertCount(), Bitset::empty());
+// Returns the set of vertices of X and their ancestors
+template <int W>
+Bitset<W> ancestorsWithSelf(const Digraph<W>& dag, Bitset<W> X) {
+    return closureWithSelf(X, [&](int v) {
+        return dag.edgesIn(v);
+    });
+}
 
-    queue<pair<int, int>> advQueue;
-    dag.neighbors(a).iterate([&](int v) {
-        advQueue.push(make_pair(a, v));
-        seenAdvs[a].add(v);
+// Returns the set of vertices of X and their descendants
+template <int W>
+Bitset<W> descendantsWithSelf(const Digraph<W>& dag, Bitset<W> X) {
+    return closureWithSelf(X, [&](int v) {
+        return dag.edgesOut(v);
     });
-    bool found = false;
-    while(!found && !advQueue.empty()) {
-        int x = advQueue.front().first;
-        int y = advQueue.front().second;
-        advQueue.pop();
-
-        auto consider = [&](int z) {
-            if(z == b) {
-                found = true;
-            }
-            advQueue.push(make_pair(y, z));
-            seenAdvs[y].add(z);
-        };
-        auto considerIn = [&]() {
-            dag.edgesIn(y).without(a).without(x).minus(seenAdvs[y]).iterate(consider);
-        };
-        auto considerOut = [&]() {
-            dag.edgesOut(y).without(a).without(x).minus(seenAdvs[y]).iterate(consider);
-        };
-
-        if(dag.edgesOut(x).contains(y)) {
-            // x -> y -> z
-            if(!X.contains(y)) {
-                considerOut();
-            }
+}
 
-            // x -> y <- z
-            if(ancestorsX.contains(y)) {
-                considerIn();
-            }
-        } else {
-            if(!X.contains(y)) {
-                // x <- y -> z
-                considerOut();
+// Returns the set of vertices in bs that are d-connected to a given X. Uses
+// the Bayes-ball reachability algorithm on whole bitsets: a vertex can be
+// entered upwards (from a child) or downwards (from a parent), and the
+// vertices entered in each direction are expanded one frontier at a time. A
+// vertex entered upwards passes the ball to its parents and children unless
+// it is in X. A vertex entered downwards passes it to its children unless it
+// is in X, and to its parents if it is an ancestor of X (or in X), which
+// opens the collider. Each vertex is expanded at most once in each direction,
+// and the sweep stops once all of bs has been reached.
+template <int W, typename F>
+Bitset<W> dConnectedVertices(
+    const Digraph<W>& dag,
+    int a,
+    Bitset<W> X,
+    Bitset<W> bs,
+    F getAncestorsX
+) {
+    // The neighbors of a are always d-connected to it
+    bs = bs.minus(X).without(a);
+    Bitset<W> reached = bs.intersectWith(dag.neighbors(a));
+    if(reached == bs) {
+        return reached;
+    }
+
+    Bitset<W> ancestorsX = getAncestorsX();
 
-                // x <- y <- z
-                considerIn();
+    // a is expanded as if entered upwards
+    Bitset<W> upSeen = Bitset<W>::singleton(a);
+    Bitset<W> downSeen = Bitset<W>::empty();
+    Bitset<W> upFrontier = upSeen;
+    Bitset<W> downFrontier = downSeen;
+    while(!upFrontier.isEmpty() || !downFrontier.isEmpty()) {
+        Bitset<W> upNext = Bitset<W>::empty();
+        Bitset<W> downNext = Bitset<W>::empty();
+        upFrontier.minus(X).iterate([&](int v) {
+            upNext = upNext.unionWith(dag.edgesIn(v));
+            downNext = downNext.unionWith(dag.edgesOut(v));
+        });
+        downFrontier.minus(X).iterate([&](int v) {
+            downNext = downNext.unionWith(dag.edgesOut(v));
+        });
+        downFrontier.intersectWith(ancestorsX).iterate([&](int v) {
+            upNext = upNext.unionWith(dag.edgesIn(v));
+        });
+
+        reached = reached.unionWith(bs.intersectWith(upNext.unionWith(downNext)));
+        if(reached == bs) {
+            break;
+        }
+        upFrontier = upNext.minus(upSeen);
+        downFrontier = downNext.minus(downSeen);
+        upSeen = upSeen.unionWith(upFrontier);
+        downSeen = downSeen.unionWith(downFrontier);
+    }
+    return reached;
+}
+
+}
+
+// The transitive closure of a DAG: the ancestors and descendants of every
+// vertex, computed once in topological order so that the ancestors of a set
+// are the union of the ancestors of its vertices. Vertices on cycles, if
+// any, are handled by walking the edges.
+template <int W>
+class DagClosure {
+public:
+    DagClosure(const Digraph<W>& dag)
+        : ancestors_(dag.vertCount(), Bitset<W>::empty()),
+          descendants_(dag.vertCount(), Bitset<W>::empty())
+    {
+        int n = dag.vertCount();
+
+        // Kahn's algorithm
+        vector<int> order;
+        vector<int> inDegree(n);
+        for(int v = 0; v < n; ++v) {
+            inDegree[v] = dag.edgesIn(v).count();
+            if(!inDegree[v]) {
+                order.push_back(v);
             }
+        }
+        for(int i = 0; i < (int)order.size(); ++i) {
+            dag.edgesOut(order[i]).iterate([&](int w) {
+                if(!--inDegree[w]) {
+                    order.push_back(w);
+                }
+            });
+        }
 
+        Bitset<W> ordered = Bitset<W>::empty();
+        for(int v : order) {
+            ordered.add(v);
         }
+
+        // The vertices left out of the order are on or after a cycle, and
+        // the ordered vertices may have them as children, so they are handled
+        // first
+        Bitset<W>::range(n).minus(ordered).iterate([&](int v) {
+            ancestors_[v] = dseparation_::ancestorsWithSelf(dag, Bitset<W>::singleton(v));
+            descendants_[v] = dseparation_::descendantsWithSelf(dag, Bitset<W>::singleton(v));
+        });
+
+        for(int v : order) {
+            ancestors_[v].add(v);
+            dag.edgesIn(v).iterate([&](int u) {
+                ancestors_[v] = ancestors_[v].unionWith(ancestors_[u]);
+            });
+        }
+        for(int i = (int)order.size() - 1; i >= 0; --i) {
+            int v = order[i];
+            descendants_[v].add(v);
+            dag.edgesOut(v).iterate([&](int w) {
+                descendants_[v] = descendants_[v].unionWith(descendants_[w]);
+            });
+        }
+    }
+
+    // The ancestors and descendants of v, including v itself
+    Bitset<W> ancestorsWithSelf(int v) const {
+        return ancestors_[v];
     }
-    return !found;
+    Bitset<W> descendantsWithSelf(int v) const {
+        return descendants_[v];
+    }
+
+    // The vertices of X and their ancestors or descendants
+    Bitset<W> ancestorsWithSelf(Bitset<W> X) const {
+        Bitset<W> ret = Bitset<W>::empty();
+        X.iterate([&](int v) {
+            ret = ret.unionWith(ancestors_[v]);
+        });
+        return ret;
+    }
+    Bitset<W> descendantsWithSelf(Bitset<W> X) const {
+        Bitset<W> ret = Bitset<W>::empty();
+        X.iterate([&](int v) {
+            ret = ret.unionWith(descendants_[v]);
+        });
+        return ret;
+    }
+
+private:
+    vector<Bitset<W>> ancestors_;
+    vector<Bitset<W>> descendants_;
+};
+
+// Returns the set of vertices in bs that are d-connected to a given X
+template <int W>
+Bitset<W> dConnectedVertices(const Digraph<W>& dag, int a, Bitset<W> X, Bitset<W> bs) {
+    return dseparation_::dConnectedVertices(dag, a, X, bs, [&]() {
+        return dseparation_::ancestorsWithSelf(dag, X);
+    });
+}
+
+// Same as above, but uses the precomputed closure of dag to find the
+// ancestors of X
+template <int W>
+Bitset<W> dConnectedVertices(
+    const Digraph<W>& dag,
+    const DagClosure<W>& closure,
+    int a,
+    Bitset<W> X,
+    Bitset<W> bs
+) {
+    return dseparation_::dConnectedVertices(dag, a, X, bs, [&]() {
+        return closure.ancestorsWithSelf(X);
+    });
+}
+
+// Returns true if a is d-separated from b given X
+template <int W>
+bool isDSeparated(const Digraph<W>& dag, int a, Bitset<W> X, int b) {
+    return dConnectedVertices(dag, a, X, Bitset<W>::singleton(b)).isEmpty();
+}
+
+// Same as above, using the precomputed closure of dag
+template <int W>
+bool isDSeparated(const Digraph<W>& dag, const DagClosure<W>& closure, int a, Bitset<W> X, int b) {
+    return dConnectedVertices(dag, closure, a, X, Bitset<W>::singleton(b)).isEmpty();
 }
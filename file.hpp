@@ -2,9 +2,17 @@
 
 #include "data.hpp"
 #include "digraph.hpp"
+#include "graph.hpp"
+#include "thread_pool.hpp"
 
-Digraph readDigraph(ifstream& fp, int vertCount) {
-    Digraph digraph(vertCount);
+#include <limits>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+template <int W>
+Digraph<W> readDigraph(ifstream& fp, int vertCount) {
+    Digraph<W> digraph(vertCount);
 
     int edgeCount;
     fp >> edgeCount;
@@ -23,8 +31,22 @@ Digraph readDigraph(ifstream& fp, int vertCount) {
     return digraph;
 }
 
+// Returns the vertex count of a preprocessed network file, which can be used
+// to choose the word count for readBnRepositoryNet
+int readBnRepositoryNetVertCount(string filename) {
+    ifstream fp;
+    fp.exceptions(fp.failbit | fp.badbit | fp.eofbit);
+    fp.open(filename);
+
+    int vertCount;
+    fp >> vertCount;
+    CHECK(vertCount >= 0);
+    return vertCount;
+}
+
 // Returns pair (DAG, CPDAG)
-pair<Digraph, Digraph> readBnRepositoryNet(string filename) {
+template <int W>
+pair<Digraph<W>, Digraph<W>> readBnRepositoryNet(string filename) {
     ifstream fp;
     fp.exceptions(fp.failbit | fp.badbit | fp.eofbit);
     fp.open(filename);
@@ -33,40 +55,339 @@ pair<Digraph, Digraph> readBnRepositoryNet(string filename) {
     fp >> vertCount;
     CHECK(
         vertCount >= 0 &&
-        vertCount <= Graph::MaxVertCount &&
-        vertCount <= Digraph::MaxVertCount
+        vertCount <= Graph<W>::MaxVertCount &&
+        vertCount <= Digraph<W>::MaxVertCount
     );
 
-    Digraph dag = readDigraph(fp, vertCount);
-    Digraph cpdag = readDigraph(fp, vertCount);
+    Digraph<W> dag = readDigraph<W>(fp, vertCount);
+    Digraph<W> cpdag = readDigraph<W>(fp, vertCount);
 
     return {move(dag), move(cpdag)};
 }
 
-Data readData(istream& in) {
+namespace file_ {
+
+inline bool isSpace(char c) {
+    return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+// Parses a nonnegative integer at pos, which must not be whitespace, and
+// advances pos past it. Values above cap are replaced by cap.
+inline uint32_t parseUnsigned(const char*& pos, const char* end, uint32_t cap) {
+    CHECK(*pos >= '0' && *pos <= '9');
+    uint64_t val = 0;
+    while(pos != end && *pos >= '0' && *pos <= '9') {
+        val = min(10 * val + (uint64_t)(*pos - '0'), (uint64_t)cap);
+        ++pos;
+    }
+    CHECK(pos == end || isSpace(*pos));
+    return (uint32_t)val;
+}
+
+// Parses the next whitespace-separated nonnegative integer of at most cap
+inline uint32_t parseNextUnsigned(const char*& pos, const char* end, uint32_t cap) {
+    while(pos != end && isSpace(*pos)) {
+        ++pos;
+    }
+    CHECK(pos != end);
+    return parseUnsigned(pos, end, cap);
+}
+
+// Returns the number of whitespace-separated tokens starting in [begin, end);
+// begin[-1] must be valid
+inline size_t countTokens(const char* begin, const char* end) {
+    size_t count = 0;
+    for(const char* pos = begin; pos != end; ++pos) {
+        count += (size_t)(!isSpace(pos[0]) & isSpace(pos[-1]));
+    }
+    return count;
+}
+
+// Reads the whole stream to memory in large blocks
+inline vector<char> readStream(istream& in) {
+    const size_t BlockSize = (size_t)1 << 24;
+    vector<char> text;
+    while(true) {
+        size_t size = text.size();
+        text.resize(size + BlockSize);
+        in.read(text.data() + size, BlockSize);
+        text.resize(size + (size_t)in.gcount());
+        if(!in) {
+            break;
+        }
+    }
+    CHECK(in.eof() && !in.bad());
+    return text;
+}
+
+const char BinaryDataMagic[8] = {'B', 'N', 'D', 'A', 'T', 'A', '0', '1'};
+
+// The size of the header of the binary data format, padded to 64 bytes
+inline size_t binaryDataHeaderSize(int varCount) {
+    size_t size = sizeof(BinaryDataMagic) + 3 * sizeof(uint32_t) + (size_t)varCount * sizeof(uint32_t);
+    return (size + (size_t)63) & ~(size_t)63;
+}
+
+// Checks that the values of column are valid categories and its padding is
+// zero. The maximum is computed without branches so that the loop vectorizes.
+template <typename T>
+void checkDataColumn(const T* column, int pointCount, int catCount, size_t columnStride) {
+    T maxVal = 0;
+    for(int i = 0; i < pointCount; ++i) {
+        maxVal = max(maxVal, column[i]);
+    }
+    CHECK((int)maxVal < catCount);
+    T padding = 0;
+    for(size_t i = pointCount; i < columnStride / sizeof(T); ++i) {
+        padding |= column[i];
+    }
+    CHECK(padding == 0);
+}
+
+}
+
+// Reads data in the text format: the variable and data point counts, the
+// category counts of the variables and the values of each data point, all
+// separated by whitespace. The text is read to memory and the values are
+// parsed in ranges of the text, one for each thread of pool and the calling
+// thread if pool is given.
+Data readData(istream& in, ThreadPool* pool = nullptr) {
+    using namespace file_;
+
+    int threadCount = pool ? pool->threadCount() + 1 : 1;
+
+    vector<char> text = readStream(in);
+    const char* pos = text.data();
+    const char* end = text.data() + text.size();
+
+    int varCount = (int)parseNextUnsigned(pos, end, INT32_MAX);
+    int pointCount = (int)parseNextUnsigned(pos, end, INT32_MAX);
+    CHECK(varCount > 0);
+    CHECK(pointCount > 0);
+
+    vector<int> catCounts(varCount);
+    for(int v = 0; v < varCount; ++v) {
+        catCounts[v] = (int)parseNextUnsigned(pos, end, Data::MaxCatCount + 1);
+        CHECK(catCounts[v] >= 2 && catCounts[v] <= Data::MaxCatCount);
+    }
+
+    Data data(move(catCounts), pointCount);
+    dispatchDataValueType(data, [&](auto t) {
+        typedef decltype(t) T;
+        vector<T*> columns(varCount);
+        for(int v = 0; v < varCount; ++v) {
+            columns[v] = data.column<T>(v);
+        }
+
+        // Split the values to ranges of at least 1 MiB, cut at whitespace.
+        // The character before pos is the end of the last header token.
+        size_t minChunkSize = (size_t)1 << 20;
+        int chunkCount = (int)min((size_t)threadCount, (size_t)(end - pos) / minChunkSize + 1);
+        vector<const char*> bounds(chunkCount + 1);
+        bounds[0] = pos;
+        bounds[chunkCount] = end;
+        for(int c = 1; c < chunkCount; ++c) {
+            const char* bound = pos + (size_t)(end - pos) * c / chunkCount;
+            bound = max(bound, bounds[c - 1]);
+            while(bound != end && !isSpace(*bound)) {
+                ++bound;
+            }
+            bounds[c] = bound;
+        }
+
+        // The index of the first token of each range is found by counting
+        // the tokens in the preceding ranges
+        vector<size_t> firstTokens(chunkCount + 1, 0);
+        auto runChunks = [&](auto f) {
+            if(chunkCount == 1) {
+                f(0);
+                return;
+            }
+            TaskGroup group(*pool);
+            for(int c = 1; c < chunkCount; ++c) {
+                group.run([&f, c]() {
+                    f(c);
+                });
+            }
+            f(0);
+            group.wait();
+        };
+        runChunks([&](int c) {
+            firstTokens[c + 1] = countTokens(bounds[c], bounds[c + 1]);
+        });
+        for(int c = 0; c < chunkCount; ++c) {
+            firstTokens[c + 1] += firstTokens[c];
+        }
+        size_t valueCount = (size_t)varCount * (size_t)pointCount;
+        CHECK(firstTokens[chunkCount] >= valueCount);
+
+        // Values too large for T are flagged as overflows, and the others are
+        // validated after parsing
+        uint32_t maxVal = (uint32_t)numeric_limits<T>::max();
+        vector<char> overflows(chunkCount, 0);
+        runChunks([&](int c) {
+            size_t token = firstTokens[c];
+            if(token >= valueCount) {
+                return;
+            }
+            int v = (int)(token % varCount);
+            size_t i = token / varCount;
+            const char* chunkPos = bounds[c];
+            const char* chunkEnd = bounds[c + 1];
+            uint32_t overflow = 0;
+            while(token < valueCount) {
+                while(chunkPos != chunkEnd && isSpace(*chunkPos)) {
+                    ++chunkPos;
+                }
+                if(chunkPos == chunkEnd) {
+                    break;
+                }
+                uint32_t val = parseUnsigned(chunkPos, end, maxVal + 1);
+                overflow |= (uint32_t)(val > maxVal);
+                columns[v][i] = (T)val;
+                ++token;
+                if(++v == varCount) {
+                    v = 0;
+                    ++i;
+                }
+            }
+            overflows[c] = (char)overflow;
+        });
+        for(char overflow : overflows) {
+            CHECK(!overflow);
+        }
+
+        for(int v = 0; v < varCount; ++v) {
+            checkDataColumn(columns[v], pointCount, data.catCount(v), data.columnStride());
+        }
+    });
+
+    return data;
+}
+
+// Writes data in the binary format: the magic string "BNDATA01", the variable
+// count, the data point count and the value size in bytes (1 or 2) as uint32,
+// the category counts as uint32 and zero padding to a multiple of 64 bytes,
+// followed by the storage of data in the layout of Data. The integers are in
+// native byte order.
+void writeBinaryData(const Data& data, ostream& out) {
+    using namespace file_;
+
+    vector<uint8_t> header(binaryDataHeaderSize(data.varCount()), 0);
+    vector<uint32_t> fields = {
+        (uint32_t)data.varCount(),
+        (uint32_t)data.pointCount(),
+        (uint32_t)(data.wide() ? sizeof(uint16_t) : sizeof(uint8_t))
+    };
+    for(int catCount : data.catCounts()) {
+        fields.push_back((uint32_t)catCount);
+    }
+    memcpy(header.data(), BinaryDataMagic, sizeof(BinaryDataMagic));
+    memcpy(header.data() + sizeof(BinaryDataMagic), fields.data(), fields.size() * sizeof(uint32_t));
+    out.write((const char*)header.data(), header.size());
+
+    dispatchDataValueType(data, [&](auto t) {
+        typedef decltype(t) T;
+        for(int v = 0; v < data.varCount(); ++v) {
+            out.write((const char*)data.column<T>(v), data.columnStride());
+        }
+    });
+    if(data.varCount() * data.columnStride() < data.storageSize()) {
+        vector<char> padding(data.storageSize() - data.varCount() * data.columnStride(), 0);
+        out.write(padding.data(), padding.size());
+    }
+    CHECK(out.good());
+}
+
+// If file descriptor fd refers to a regular file in the binary format of
+// writeBinaryData, maps the file to memory, sets data to use the mapping as
+// its storage without copying and returns true. Otherwise, returns false
+// without reading from fd. The mapping is private, so writing to the columns
+// does not change the file. The values are checked to be valid, which reads
+// the whole file once.
+bool tryMapBinaryData(int fd, Data& data) {
+    using namespace file_;
+
+    struct stat st;
+    if(fstat(fd, &st) || !S_ISREG(st.st_mode)) {
+        return false;
+    }
+    size_t fileSize = (size_t)st.st_size;
+
+    char magic[sizeof(BinaryDataMagic)];
+    if(
+        fileSize < sizeof(magic) ||
+        pread(fd, magic, sizeof(magic), 0) != (ssize_t)sizeof(magic) ||
+        memcmp(magic, BinaryDataMagic, sizeof(magic))
+    ) {
+        return false;
+    }
+
+    void* mapping = mmap(nullptr, fileSize, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    CHECK(mapping != MAP_FAILED);
+    shared_ptr<uint8_t> base((uint8_t*)mapping, [fileSize](uint8_t* p) {
+        munmap(p, fileSize);
+    });
+
+    uint32_t fields[3];
+    CHECK(fileSize >= sizeof(magic) + sizeof(fields));
+    memcpy(fields, base.get() + sizeof(magic), sizeof(fields));
+    int varCount = (int)fields[0];
+    int pointCount = (int)fields[1];
+    size_t valueSize = fields[2];
+    CHECK(varCount > 0 && fields[0] <= (uint32_t)INT32_MAX);
+    CHECK(pointCount > 0 && fields[1] <= (uint32_t)INT32_MAX);
+
+    size_t headerSize = binaryDataHeaderSize(varCount);
+    CHECK(fileSize >= headerSize);
+    vector<int> catCounts(varCount);
+    for(int v = 0; v < varCount; ++v) {
+        uint32_t catCount;
+        memcpy(&catCount, base.get() + sizeof(magic) + sizeof(fields) + v * sizeof(uint32_t), sizeof(uint32_t));
+        CHECK(catCount >= 2 && catCount <= (uint32_t)Data::MaxCatCount);
+        catCounts[v] = (int)catCount;
+    }
+
+    // The storage shares the ownership of the whole mapping
+    shared_ptr<uint8_t> storage(base, base.get() + headerSize);
+    data = Data(move(catCounts), pointCount, move(storage));
+    CHECK(valueSize == (data.wide() ? sizeof(uint16_t) : sizeof(uint8_t)));
+    CHECK(fileSize == headerSize + data.storageSize());
+
+    dispatchDataValueType(data, [&](auto t) {
+        typedef decltype(t) T;
+        for(int v = 0; v < varCount; ++v) {
+            checkDataColumn(data.column<T>(v), pointCount, data.catCount(v), data.columnStride());
+        }
+    });
+
+    return true;
+}
+
+// Reads continuous data in the format of readData without the category counts:
+// the variable and data point counts followed by the values of each data
+// point
+ContinuousData readContinuousData(istream& in) {
     int varCount, pointCount;
     in >> varCount >> pointCount;
     CHECK(in.good());
     CHECK(varCount > 0);
     CHECK(pointCount > 0);
 
-    Data data;
-    data.catCounts.resize(varCount);
+    ContinuousData data(varCount, pointCount);
+    vector<double*> columns(varCount);
     for(int v = 0; v < varCount; ++v) {
-        in >> data.catCounts[v];
-        CHECK(in.good());
-        CHECK(data.catCounts[v] >= 2);
+        columns[v] = data.column(v);
     }
-
-    data.points.resize(pointCount);
     for(int i = 0; i < pointCount; ++i) {
-        data.points[i].resize(varCount);
         for(int v = 0; v < varCount; ++v) {
-            in >> data.points[i][v];
-            CHECK(in.good());
-            CHECK(data.points[i][v] >= 0 && data.points[i][v] < data.catCounts[v]);
+            double val;
+            in >> val;
+            CHECK(!in.fail());
+            CHECK(isfinite(val));
+            columns[v][i] = val;
         }
     }
-    
+
     return data;
 }
@@ -0,0 +1,334 @@
+#pragma once
+
+#include "bitset.hpp"
+#include "data.hpp"
+#include "independence_test.hpp"
+#include "lru_cache.hpp"
+
+#include <boost/math/distributions/normal.hpp>
+
+namespace fisher_z_ {
+
+// The number of data points processed at once when computing the correlation
+// matrix. The centered values of a block of one variable fit in L1 cache.
+const int CorrelationBlockSize = 512;
+
+// Returns the dot product of x and y of length n, which must be a multiple of
+// 8. The independent accumulators let the compiler vectorize the loop.
+inline double dotProduct(const double* x, const double* y, int n) {
+    double acc[8] = {0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0};
+    for(int i = 0; i < n; i += 8) {
+        for(int j = 0; j < 8; ++j) {
+            acc[j] += x[i + j] * y[i + j];
+        }
+    }
+    return ((acc[0] + acc[1]) + (acc[2] + acc[3])) + ((acc[4] + acc[5]) + (acc[6] + acc[7]));
+}
+
+// Residual variances (of standardized variables) below this are treated as
+// zero, that is, the variable as a linear function of the conditioning set
+const double SingularEps = 1e-10;
+
+// The regression of all the variables on a conditioning set X, obtained by
+// Gram-Schmidt orthonormalization of the variables of X in increasing order
+// (equivalently, incremental Cholesky factorization of the correlation matrix
+// of X). The node for X extends the node for X without its largest variable v
+// by the normalized residual e of v; coefs[u] is the correlation of variable u
+// with e. Variables of X that are linear functions of the previous ones add no
+// node, as conditioning on them has no effect.
+struct Residuals {
+    shared_ptr<const Residuals> parent;
+
+    // The number of nodes in the chain up to the root
+    int depth;
+
+    // Empty for the root, which corresponds to the empty conditioning set
+    vector<double> coefs;
+
+    // variances[u] is the residual variance of variable u given X
+    vector<double> variances;
+};
+
+inline size_t residualsSize(const Residuals& residuals) {
+    return
+        sizeof(Residuals) +
+        residuals.coefs.size() * sizeof(double) +
+        residuals.variances.size() * sizeof(double);
+}
+
+// Returns the coefficient arrays of the chain ending at residuals
+inline vector<const double*> residualCoefs(const Residuals& residuals) {
+    vector<const double*> ret(residuals.depth);
+    const Residuals* node = &residuals;
+    for(int j = residuals.depth - 1; j >= 0; --j) {
+        ret[j] = node->coefs.data();
+        node = node->parent.get();
+    }
+    return ret;
+}
+
+}
+
+// Sample correlation matrix of continuous data, computed in one pass over the
+// data. The data is processed in blocks whose cross products are computed
+// from values centered at the block mean and merged into the totals using
+// the pairwise update formula, which keeps the result accurate also for
+// variables with a large mean. The correlations of a constant variable are
+// zero, including with itself.
+class CorrelationMatrix {
+public:
+    CorrelationMatrix(const ContinuousData& data)
+        : varCount_(data.varCount()),
+          pointCount_(data.pointCount()),
+          corr_((size_t)varCount_ * varCount_, 0.0)
+    {
+        using namespace fisher_z_;
+
+        const int B = CorrelationBlockSize;
+        int n = varCount_;
+
+        // Running means and sums of the cross products of the deviations
+        // from the means; only the upper triangle is used
+        double count = 0.0;
+        vector<double> means(n, 0.0);
+        vector<double> sums((size_t)n * n, 0.0);
+
+        vector<double> blockMeans(n);
+        vector<double> deltas(n);
+        vector<double> centered((size_t)n * B);
+        for(int start = 0; start < pointCount_; start += B) {
+            int size = min(B, pointCount_ - start);
+
+            for(int v = 0; v < n; ++v) {
+                const double* col = data.column(v) + start;
+                double* dst = &centered[(size_t)v * B];
+                double sum = 0.0;
+                for(int i = 0; i < size; ++i) {
+                    sum += col[i];
+                }
+                double mean = sum / (double)size;
+                for(int i = 0; i < size; ++i) {
+                    dst[i] = col[i] - mean;
+                }
+                // Zero padding to a multiple of 8 for dotProduct
+                fill(dst + size, dst + B, 0.0);
+                blockMeans[v] = mean;
+            }
+
+            double blockCount = (double)size;
+            double total = count + blockCount;
+            for(int v = 0; v < n; ++v) {
+                deltas[v] = blockMeans[v] - means[v];
+            }
+            double mul = count * blockCount / total;
+            int paddedSize = (size + 7) & ~7;
+            for(int a = 0; a < n; ++a) {
+                const double* x = &centered[(size_t)a * B];
+                double* row = &sums[(size_t)a * n];
+                for(int b = a; b < n; ++b) {
+                    row[b] +=
+                        dotProduct(x, &centered[(size_t)b * B], paddedSize) +
+                        deltas[a] * deltas[b] * mul;
+                }
+            }
+            for(int v = 0; v < n; ++v) {
+                means[v] += deltas[v] * blockCount / total;
+            }
+            count = total;
+        }
+
+        vector<double> invNorms(n);
+        for(int v = 0; v < n; ++v) {
+            double sqSum = sums[(size_t)v * n + v];
+            invNorms[v] = sqSum > 0.0 ? 1.0 / sqrt(sqSum) : 0.0;
+        }
+        for(int a = 0; a < n; ++a) {
+            for(int b = a; b < n; ++b) {
+                double val = sums[(size_t)a * n + b] * invNorms[a] * invNorms[b];
+                if(a == b && val != 0.0) {
+                    val = 1.0;
+                }
+                corr_[(size_t)a * n + b] = val;
+                corr_[(size_t)b * n + a] = val;
+            }
+        }
+    }
+
+    int varCount() const {
+        return varCount_;
+    }
+    int pointCount() const {
+        return pointCount_;
+    }
+
+    double get(int a, int b) const {
+        return corr_[(size_t)a * varCount_ + b];
+    }
+
+    // The correlations of variable a with all the variables
+    const double* row(int a) const {
+        return &corr_[(size_t)a * varCount_];
+    }
+
+private:
+    int varCount_;
+    int pointCount_;
+    vector<double> corr_;
+};
+
+// Fisher's z-test of zero partial correlation at significance level alpha for
+// continuous data, assuming the data is multivariate Gaussian. The tests use
+// only the correlation matrix of the data, so their cost does not depend on
+// the number of data points. The regressions of the variables on the
+// conditioning sets X are cached in at most residualCacheMemoryCap bytes, and
+// the regression on X is obtained from the regression on X without its
+// largest variable in time linear in the number of variables. A test of a
+// pair then takes time linear in |X|.
+template <int W>
+class FisherZTest : public IndependenceTest<W> {
+public:
+    // corr must outlive the test
+    FisherZTest(
+        const CorrelationMatrix& corr,
+        double alpha = 0.05,
+        size_t residualCacheMemoryCap = 0
+    )
+        : corr_(corr)
+    {
+        using namespace fisher_z_;
+
+        int varCount = corr.varCount();
+        CHECK(varCount <= Bitset<W>::BitCount);
+        CHECK(corr.pointCount() > 0);
+        CHECK(alpha > 0.0 && alpha < 1.0);
+
+        boost::math::normal_distribution<> dist;
+        criticalValue_ = boost::math::quantile(dist, 1.0 - 0.5 * alpha);
+
+        if(residualCacheMemoryCap) {
+            cache_.reset(new LruCache<Bitset<W>, Residuals>(residualCacheMemoryCap));
+        }
+
+        shared_ptr<Residuals> root = make_shared<Residuals>();
+        root->depth = 0;
+        root->variances.resize(varCount);
+        for(int v = 0; v < varCount; ++v) {
+            root->variances[v] = corr.get(v, v);
+        }
+        root_ = move(root);
+    }
+
+    int varCount() const override {
+        return corr_.varCount();
+    }
+
+    vector<bool> indTests(Bitset<W> X, const vector<pair<int, int>>& pairs) override {
+        using namespace fisher_z_;
+
+        int varCount = corr_.varCount();
+        CHECK(X.isSubsetOf(Bitset<W>::range(varCount)));
+        for(pair<int, int> p : pairs) {
+            CHECK(p.first >= 0 && p.first < varCount);
+            CHECK(p.second >= 0 && p.second < varCount);
+            CHECK(p.first != p.second);
+            CHECK(!X.contains(p.first));
+            CHECK(!X.contains(p.second));
+        }
+
+        vector<bool> ret(pairs.size());
+
+        // With too few data points, there is no evidence of dependence
+        double freedom = (double)corr_.pointCount() - (double)X.count() - 3.0;
+        if(freedom <= 0.0) {
+            fill(ret.begin(), ret.end(), true);
+            return ret;
+        }
+        double scale = sqrt(freedom);
+
+        shared_ptr<const Residuals> residuals = residuals_(X);
+        vector<const double*> coefs = residualCoefs(*residuals);
+        const vector<double>& variances = residuals->variances;
+
+        for(int i = 0; i < (int)pairs.size(); ++i) {
+            int a = pairs[i].first;
+            int b = pairs[i].second;
+
+            // A variable determined by X is independent of everything given X
+            if(variances[a] <= SingularEps || variances[b] <= SingularEps) {
+                ret[i] = true;
+                continue;
+            }
+
+            double cov = corr_.get(a, b);
+            for(const double* c : coefs) {
+                cov -= c[a] * c[b];
+            }
+
+            double r = cov / sqrt(variances[a] * variances[b]);
+            r = min(max(r, -1.0 + 1e-15), 1.0 - 1e-15);
+            double z = scale * atanh(r);
+            ret[i] = abs(z) < criticalValue_;
+        }
+        return ret;
+    }
+
+private:
+    const CorrelationMatrix& corr_;
+    double criticalValue_;
+    shared_ptr<const fisher_z_::Residuals> root_;
+    unique_ptr<LruCache<Bitset<W>, fisher_z_::Residuals>> cache_;
+
+    // Returns the regression on X, extending the regression on X without its
+    // largest variable
+    shared_ptr<const fisher_z_::Residuals> residuals_(Bitset<W> X) {
+        using namespace fisher_z_;
+
+        if(X.isEmpty()) {
+            return root_;
+        }
+        if(cache_) {
+            shared_ptr<const Residuals> cached = cache_->find(X);
+            if(cached) {
+                return cached;
+            }
+        }
+
+        int v = -1;
+        X.iterate([&](int x) {
+            v = x;
+        });
+        shared_ptr<const Residuals> parent = residuals_(X.without(v));
+
+        shared_ptr<const Residuals> ret;
+        double variance = parent->variances[v];
+        if(variance <= SingularEps) {
+            ret = parent;
+        } else {
+            int varCount = corr_.varCount();
+            shared_ptr<Residuals> node = make_shared<Residuals>();
+            node->depth = parent->depth + 1;
+
+            // coefs[u] = (corr(v, u) - sum_j c_j[v] c_j[u]) / sqrt(variance)
+            node->coefs.assign(corr_.row(v), corr_.row(v) + varCount);
+            for(const double* c : residualCoefs(*parent)) {
+                double cv = c[v];
+                for(int u = 0; u < varCount; ++u) {
+                    node->coefs[u] -= cv * c[u];
+                }
+            }
+            double mul = 1.0 / sqrt(variance);
+            node->variances.resize(varCount);
+            for(int u = 0; u < varCount; ++u) {
+                node->coefs[u] *= mul;
+                node->variances[u] = parent->variances[u] - node->coefs[u] * node->coefs[u];
+            }
+            node->parent = move(parent);
+            ret = move(node);
+        }
+
+        if(cache_) {
+            cache_->insert(X, ret, residualsSize(*ret));
+        }
+        return ret;
+    }
+};
@@ -0,0 +1,245 @@
+#pragma once
+
+#include "bitset.hpp"
+#include "memo_budget.hpp"
+
+#include <type_traits>
+
+namespace flat_hash_map_ {
+
+// The mixing primitive of wyhash: the 128-bit product of a and b folded to
+// 64 bits
+inline uint64_t mum(uint64_t a, uint64_t b) {
+    __uint128_t product = (__uint128_t)a * (__uint128_t)b;
+    return (uint64_t)product ^ (uint64_t)(product >> 64);
+}
+
+const uint64_t HashSecret0 = 0xa0761d6478bd642f;
+const uint64_t HashSecret1 = 0xe7037ed1a0b428db;
+const uint64_t HashSecret2 = 0x8ebc6af09c88c6e3;
+const uint64_t HashSecret3 = 0x589965cc75374cc3;
+
+// Calls f(x) for each 64-bit word x of key
+template <int W, typename F>
+void keyWords(const Bitset<W>& key, F f) {
+    for(int w = 0; w < W; ++w) {
+        f(key.word(w));
+    }
+}
+template <typename F>
+void keyWords(int key, F f) {
+    f((uint64_t)(uint32_t)key);
+}
+template <typename A, typename B, typename F>
+void keyWords(const pair<A, B>& key, F f) {
+    keyWords(key.first, f);
+    keyWords(key.second, f);
+}
+
+}
+
+// Hashes the words of key two at a time in the style of wyhash
+template <typename K>
+uint64_t hashKey(const K& key) {
+    using namespace flat_hash_map_;
+
+    uint64_t h = HashSecret0;
+    uint64_t pending = 0;
+    int wordCount = 0;
+    keyWords(key, [&](uint64_t x) {
+        if(wordCount & 1) {
+            h = mum(pending ^ HashSecret1, x ^ h);
+        } else {
+            pending = x;
+        }
+        ++wordCount;
+    });
+    if(wordCount & 1) {
+        h = mum(pending ^ HashSecret1, h ^ HashSecret2);
+    }
+    return mum(h ^ HashSecret3, (uint64_t)wordCount ^ HashSecret1);
+}
+
+// Open addressing hash map for trivially destructible keys and values, in the
+// style of SwissTable. The entries are stored in a single flat allocation
+// that starts with one control byte per slot: 0 for an empty slot, and for a
+// full one, 0x80 ORed with the low 6 bits of the hash of the key and the used
+// bit 0x40, which is set when the entry is found. The slots are probed in
+// aligned groups of 16, starting from the group given by the hash; the
+// control bytes of a group are compared to the tag of the key at once with
+// SSE2, so that the keys are only compared for the slots whose tags match.
+// The table grows to twice its size when it is 7/8 full. The hash of the key
+// is given by the caller and must be hashKey(key).
+//
+// If the map has a memory budget and growing would not fit in it, the map
+// evicts entries instead, in the style of the CLOCK algorithm: the table is
+// rebuilt in the same size with only the entries found since the previous
+// eviction, but at most half of the growth limit of them.
+template <typename K, typename V>
+class FlatHashMap {
+public:
+    // The entries are never destroyed
+    static_assert(is_trivially_destructible<K>::value, "FlatHashMap keys must be trivially destructible");
+    static_assert(is_trivially_destructible<V>::value, "FlatHashMap values must be trivially destructible");
+
+    struct Entry {
+        K key;
+        V value;
+    };
+
+    FlatHashMap()
+        : groupMask_(0),
+          size_(0),
+          growthLimit_(0),
+          budget_(nullptr),
+          ctrl_(nullptr),
+          entries_(nullptr)
+    {}
+
+    FlatHashMap(const FlatHashMap&) = delete;
+    FlatHashMap& operator=(const FlatHashMap&) = delete;
+    FlatHashMap(FlatHashMap&&) = delete;
+    FlatHashMap& operator=(FlatHashMap&&) = delete;
+
+    // Sets the memory budget of the map, which must be empty
+    void setBudget(MemoBudget* budget) {
+        CHECK(!storage_);
+        budget_ = budget;
+    }
+
+    size_t size() const {
+        return size_;
+    }
+    size_t capacity() const {
+        return storage_ ? (groupMask_ + 1) * GroupSize : 0;
+    }
+    size_t memoryUsage() const {
+        return storage_.size();
+    }
+
+    // Returns the value of key, or null if key is not in the map. The
+    // pointer is valid until the next insertion.
+    V* find(const K& key, uint64_t hash) {
+        if(!storage_) {
+            return nullptr;
+        }
+        __m128i tag = _mm_set1_epi8((char)tag_(hash));
+        __m128i tagMask = _mm_set1_epi8((char)~UsedBit);
+        size_t group = hash >> 6;
+        while(true) {
+            group &= groupMask_;
+            __m128i ctrl = _mm_load_si128((const __m128i*)(ctrl_ + group * GroupSize));
+            __m128i tags = _mm_and_si128(ctrl, tagMask);
+            uint32_t matches = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(tags, tag));
+            while(matches) {
+                size_t idx = group * GroupSize + __builtin_ctz(matches);
+                if(entries_[idx].key == key) {
+                    ctrl_[idx] |= UsedBit;
+                    return &entries_[idx].value;
+                }
+                matches &= matches - 1;
+            }
+            if(_mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_setzero_si128()))) {
+                return nullptr;
+            }
+            ++group;
+        }
+    }
+
+    // Adds key with value if key is not in the map. Returns the value of key
+    // in the map and whether it was added.
+    pair<V*, bool> insert(const K& key, const V& value, uint64_t hash) {
+        V* found = find(key, hash);
+        if(found) {
+            return {found, false};
+        }
+        if(size_ >= growthLimit_) {
+            if(!storage_) {
+                rehash_(GroupSize, SIZE_MAX);
+            } else if(!budget_ || budget_->fits(storageSize_(2 * capacity()))) {
+                rehash_(2 * capacity(), SIZE_MAX);
+            } else {
+                size_t oldSize = size_;
+                rehash_(capacity(), growthLimit_ / 2);
+                budget_->evicted(oldSize - size_);
+            }
+        }
+        Entry* entry = insertNew_(key, value, tag_(hash), hash);
+        ++size_;
+        return {&entry->value, true};
+    }
+
+private:
+    static constexpr size_t GroupSize = 16;
+    static constexpr uint8_t UsedBit = 0x40;
+
+    size_t groupMask_;
+    size_t size_;
+    size_t growthLimit_;
+    MemoBudget* budget_;
+
+    // The control bytes followed by the entries
+    MemoStorage storage_;
+    uint8_t* ctrl_;
+    Entry* entries_;
+
+    static uint8_t tag_(uint64_t hash) {
+        return (uint8_t)(0x80 | (hash & 0x3F));
+    }
+
+    static size_t storageSize_(size_t capacity) {
+        size_t entryOffset = (capacity + alignof(Entry) - 1) / alignof(Entry) * alignof(Entry);
+        return entryOffset + capacity * sizeof(Entry);
+    }
+
+    // Adds key with control byte ctrlByte assuming that it is not in the map
+    // and there is room for it
+    Entry* insertNew_(const K& key, const V& value, uint8_t ctrlByte, uint64_t hash) {
+        size_t group = hash >> 6;
+        while(true) {
+            group &= groupMask_;
+            __m128i ctrl = _mm_load_si128((const __m128i*)(ctrl_ + group * GroupSize));
+            uint32_t empties = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_setzero_si128()));
+            if(empties) {
+                size_t idx = group * GroupSize + __builtin_ctz(empties);
+                ctrl_[idx] = ctrlByte;
+                return new(&entries_[idx]) Entry{key, value};
+            }
+            ++group;
+        }
+    }
+
+    // Moves the entries to new storage with newCapacity slots. If there are
+    // more than maxSize entries, only the first maxSize used entries are kept,
+    // and their used bits are cleared.
+    void rehash_(size_t newCapacity, size_t maxSize) {
+        CHECK(newCapacity % GroupSize == 0);
+        CHECK((newCapacity & (newCapacity - 1)) == 0);
+
+        MemoStorage oldStorage = move(storage_);
+        uint8_t* oldCtrl = ctrl_;
+        Entry* oldEntries = entries_;
+        size_t oldCapacity = oldStorage ? (groupMask_ + 1) * GroupSize : 0;
+        bool evict = maxSize < size_;
+
+        storage_ = MemoStorage(storageSize_(newCapacity), budget_);
+        ctrl_ = (uint8_t*)storage_.data();
+        entries_ = (Entry*)(ctrl_ + (storageSize_(newCapacity) - newCapacity * sizeof(Entry)));
+        groupMask_ = newCapacity / GroupSize - 1;
+        growthLimit_ = newCapacity - newCapacity / 8;
+        size_ = 0;
+
+        for(size_t i = 0; i < oldCapacity && size_ < maxSize; ++i) {
+            uint8_t ctrl = oldCtrl[i];
+            if(!ctrl || (evict && !(ctrl & UsedBit))) {
+                continue;
+            }
+            if(evict) {
+                ctrl &= ~UsedBit;
+            }
+            const Entry& entry = oldEntries[i];
+            insertNew_(entry.key, entry.value, ctrl, hashKey(entry.key));
+            ++size_;
+        }
+    }
+};
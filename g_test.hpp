@@ -0,0 +1,96 @@
+#pragma once
+
+#include "chi_squared_critical.hpp"
+#include "contingency_counter.hpp"
+#include "independence_test.hpp"
+
+namespace g_test_ {
+
+// Computes the G-test (likelihood-ratio test) at significance level alpha for
+// a and b from their contingency tables in the strata of X; configCount is
+// the number of configurations of X. The statistic G = 2 sum O ln(O / E) is
+// 2N times the conditional mutual information of a and b given X in nats, so
+// this is also the mutual information test.
+inline bool testContingencyTables(
+    const ContingencyTables& tables,
+    double configCount,
+    double alpha
+) {
+    int aCatCount = tables.aCatCount;
+    int bCatCount = tables.bCatCount;
+
+    double g = 0.0;
+    iterateStrata(tables, [&](
+        const uint32_t* counts,
+        const uint32_t* aCounts,
+        const uint32_t* bCounts,
+        uint32_t total
+    ) {
+        double N = (double)total;
+        for(int bVal = 0; bVal < bCatCount; ++bVal) {
+            for(int aVal = 0; aVal < aCatCount; ++aVal) {
+                uint32_t count = counts[bVal * aCatCount + aVal];
+                if(count != 0) {
+                    double O = (double)count;
+                    g += O * log(O * N / ((double)aCounts[aVal] * (double)bCounts[bVal]));
+                }
+            }
+        }
+    });
+    g *= 2.0;
+
+    double freedom = contingencyFreedom(tables, configCount);
+    return g < chiSquaredCriticalValue(freedom, alpha);
+}
+
+}
+
+// Runs the G-test for each pair (a, b) in pairs with the same conditioning set
+// X, counting the contingency tables with counter. Returns a vector where
+// element i is true if pairs[i].first is independent of pairs[i].second given
+// X at significance level alpha.
+template <int W>
+vector<bool> gTestIndTests(
+    ContingencyCounter<W>& counter,
+    Bitset<W> X,
+    const vector<pair<int, int>>& pairs,
+    double alpha = 0.05
+) {
+    using namespace g_test_;
+
+    double configCount = 1.0;
+    X.iterate([&](int v) {
+        configCount *= (double)counter.data().catCount(v);
+    });
+
+    vector<bool> ret(pairs.size());
+    counter.count(X, pairs, [&](int i, const ContingencyTables& tables) {
+        ret[i] = testContingencyTables(tables, configCount, alpha);
+    });
+    return ret;
+}
+
+// The G-test at significance level alpha on the data of a contingency counter,
+// which must outlive the test
+template <int W>
+class GTest : public IndependenceTest<W> {
+public:
+    GTest(ContingencyCounter<W>& counter, double alpha = 0.05)
+        : counter_(counter),
+          alpha_(alpha)
+    {
+        CHECK(alpha > 0.0 && alpha < 1.0);
+    }
+
+    int varCount() const override {
+        return counter_.data().varCount();
+    }
+
+    vector<bool> indTests(Bitset<W> X, const vector<pair<int, int>>& pairs) override {
+        return gTestIndTests(counter_, X, pairs, alpha_);
+    }
+
+private:
+    ContingencyCounter<W>& counter_;
+    double alpha_;
+};
@@ -0,0 +1,56 @@
+#!/usr/bin/env python3
+
+# Samples data from a linear Gaussian structural equation model on the DAG of a
+# preprocessed network file: each variable is a weighted sum of its parents
+# plus standard normal noise, with random weights of absolute value 0.5..1.5.
+# Usage: ./gen_gaussian_data.py <preprocessed network file> <count> [seed]
+
+import random
+import sys
+
+filename = sys.argv[1]
+count = int(sys.argv[2])
+seed = int(sys.argv[3]) if len(sys.argv) > 3 else 0
+
+rng = random.Random(seed)
+
+with open(filename) as fp:
+    tokens = fp.read().split()
+var_count = int(tokens[0])
+edge_count = int(tokens[1])
+parents = [[] for v in range(var_count)]
+for e in range(edge_count):
+    a = int(tokens[2 + 2 * e])
+    b = int(tokens[3 + 2 * e])
+    parents[b].append(a)
+
+# Topological order of the DAG
+order = []
+state = [0] * var_count
+def visit(v):
+    if state[v] == 2:
+        return
+    assert state[v] == 0
+    state[v] = 1
+    for p in parents[v]:
+        visit(p)
+    state[v] = 2
+    order.append(v)
+sys.setrecursionlimit(max(1000, 2 * var_count + 100))
+for v in range(var_count):
+    visit(v)
+
+weights = [
+    [rng.choice((-1, 1)) * rng.uniform(0.5, 1.5) for p in parents[v]]
+    for v in range(var_count)
+]
+
+print("{} {}".format(var_count, count))
+vals = [0.0] * var_count
+for i in range(count):
+    for v in order:
+        val = rng.gauss(0.0, 1.0)
+        for p, w in zip(parents[v], weights[v]):
+            val += w * vals[p]
+        vals[v] = val
+    print(" ".join(repr(vals[v]) for v in range(var_count)))
@@ -2,21 +2,22 @@
 
 #include "bitset.hpp"
 
+template <int W>
 class Graph {
 public:
-    static constexpr int MaxVertCount = Bitset::BitCount;
-    static_assert(MaxVertCount <= Bitset::BitCount);
+    static constexpr int MaxVertCount = Bitset<W>::BitCount;
 
     Graph() : Graph(0) {}
-    Graph(int vertCount) : vertCount_(vertCount) {
+    Graph(int vertCount)
+        : vertCount_(vertCount),
+          adjacentVerts_(vertCount, Bitset<W>::empty())
+    {
         CHECK(vertCount >= 0 && vertCount <= MaxVertCount);
-        fill(adjacentVerts_, adjacentVerts_ + vertCount_, Bitset::empty());
     }
     static Graph complete(int vertCount) {
         CHECK(vertCount >= 0 && vertCount <= MaxVertCount);
-        Bitset allVerts = Bitset::range(vertCount);
-        Graph ret = Graph(Uninitialized());
-        ret.vertCount_ = vertCount;
+        Bitset<W> allVerts = Bitset<W>::range(vertCount);
+        Graph ret(vertCount);
         for(int v = 0; v < vertCount; ++v) {
             ret.adjacentVerts_[v] = allVerts.without(v);
         }
@@ -26,7 +27,7 @@ public:
     int vertCount() const {
         return vertCount_;
     }
-    Bitset adjacentVerts(int v) const {
+    Bitset<W> adjacentVerts(int v) const {
         CHECK(v >= 0 && v < vertCount_);
         return adjacentVerts_[v];
     }
@@ -69,9 +70,6 @@ public:
     }
 
 private:
-    struct Uninitialized {};
-    Graph(Uninitialized) {}
-
     int vertCount_;
-    Bitset adjacentVerts_[MaxVertCount];
+    vector<Bitset<W>> adjacentVerts_;
 };
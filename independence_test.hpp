@@ -0,0 +1,20 @@
+#pragma once
+
+#include "bitset.hpp"
+
+// Statistical conditional independence test used by BayesianOracle. The
+// implementations must allow indTests to be called from multiple threads
+// concurrently.
+template <int W>
+class IndependenceTest {
+public:
+    virtual ~IndependenceTest() {}
+
+    // The number of variables
+    virtual int varCount() const = 0;
+
+    // Returns a vector where element i is true if pairs[i].first is
+    // independent of pairs[i].second given X. The pairs may be checked to be
+    // valid queries.
+    virtual vector<bool> indTests(Bitset<W> X, const vector<pair<int, int>>& pairs) = 0;
+};
@@ -0,0 +1,109 @@
+#pragma once
+
+#include "common.hpp"
+
+#include <list>
+
+// Thread-safe LRU cache of shared immutable values, limited to a given total
+// memory usage. The memory usage of each value is estimated by the caller.
+template <typename K, typename V>
+class LruCache {
+public:
+    LruCache(size_t memoryCap)
+        : shardMemoryCap_(memoryCap / ShardCount),
+          shards_(new Shard[ShardCount]),
+          evictionCount_(0)
+    {}
+
+    LruCache(const LruCache&) = delete;
+    LruCache(LruCache&&) = delete;
+    LruCache& operator=(const LruCache&) = delete;
+    LruCache& operator=(LruCache&&) = delete;
+
+    // Returns the value of key and marks it recently used, or null if it is
+    // not in the cache
+    shared_ptr<const V> find(const K& key) {
+        Shard& shard = shards_[shardIdx_(key)];
+        lock_guard<SpinLock> lock(shard.lock);
+        auto iter = shard.index.find(key);
+        if(iter == shard.index.end()) {
+            return nullptr;
+        }
+        shard.entries.splice(shard.entries.begin(), shard.entries, iter->second);
+        return iter->second->value;
+    }
+
+    // Adds the value of key, taking valueSize bytes, evicting the least
+    // recently used values as needed. Values that would take more than the
+    // share of the memory cap of one shard are not added.
+    void insert(const K& key, shared_ptr<const V> value, size_t valueSize) {
+        size_t size = valueSize + EntryOverhead;
+        if(size > shardMemoryCap_) {
+            return;
+        }
+
+        Shard& shard = shards_[shardIdx_(key)];
+        lock_guard<SpinLock> lock(shard.lock);
+        if(shard.index.count(key)) {
+            return;
+        }
+        while(shard.memoryUsage + size > shardMemoryCap_) {
+            Entry& entry = shard.entries.back();
+            shard.memoryUsage -= entry.size;
+            shard.index.erase(entry.key);
+            shard.entries.pop_back();
+            evictionCount_.fetch_add(1, memory_order_relaxed);
+        }
+        shard.entries.push_front({key, move(value), size});
+        shard.index.emplace(key, shard.entries.begin());
+        shard.memoryUsage += size;
+    }
+
+    uint64_t evictionCount() const {
+        return evictionCount_.load(memory_order_relaxed);
+    }
+
+    // The estimated memory usage of the cached values in bytes
+    size_t memoryUsage() const {
+        size_t ret = 0;
+        for(int i = 0; i < ShardCount; ++i) {
+            lock_guard<SpinLock> lock(shards_[i].lock);
+            ret += shards_[i].memoryUsage;
+        }
+        return ret;
+    }
+
+private:
+    struct Entry {
+        K key;
+        shared_ptr<const V> value;
+        size_t size;
+    };
+
+    // Estimate of the memory taken by an entry in addition to the value,
+    // including the list node and the index
+    static constexpr size_t EntryOverhead = sizeof(Entry) + 6 * sizeof(void*) + sizeof(K);
+
+    static constexpr int ShardBits = 4;
+    static constexpr int ShardCount = 1 << ShardBits;
+    struct Shard {
+        Shard() : memoryUsage(0) {}
+
+        SpinLock lock;
+
+        // Most recently used first
+        list<Entry> entries;
+        unordered_map<K, typename list<Entry>::iterator> index;
+        size_t memoryUsage;
+    };
+
+    size_t shardMemoryCap_;
+    unique_ptr<Shard[]> shards_;
+
+    atomic<uint64_t> evictionCount_;
+
+    static int shardIdx_(const K& key) {
+        uint64_t h = hash<K>()(key);
+        return (int)((h * (uint64_t)0x9e3779b97f4a7c15) >> (64 - ShardBits));
+    }
+};
@@ -0,0 +1,184 @@
+#include "bayesian_oracle.hpp"
+#include "bayesian_solve.hpp"
+#include "file.hpp"
+
+// Allocator that counts the bytes allocated by a container
+template <typename T>
+struct CountingAllocator {
+    typedef T value_type;
+
+    CountingAllocator(size_t& bytes) : bytes(&bytes) {}
+    template <typename U>
+    CountingAllocator(const CountingAllocator<U>& other) : bytes(other.bytes) {}
+
+    T* allocate(size_t n) {
+        *bytes += n * sizeof(T);
+        return allocator<T>().allocate(n);
+    }
+    void deallocate(T* ptr, size_t n) {
+        *bytes -= n * sizeof(T);
+        allocator<T>().deallocate(ptr, n);
+    }
+
+    template <typename U>
+    bool operator==(const CountingAllocator<U>& other) const {
+        return bytes == other.bytes;
+    }
+    template <typename U>
+    bool operator!=(const CountingAllocator<U>& other) const {
+        return bytes != other.bytes;
+    }
+
+    size_t* bytes;
+};
+
+// Random keys resembling those of the solver memo tables on a graph of 100
+// vertices: a few cops and a random set of the other vertices, or a few cops
+// and a robber position
+static Bitset<2> randomCops(mt19937_64& rng) {
+    Bitset<2> cops = Bitset<2>::empty();
+    int copCount = 1 + (int)(rng() % 6);
+    for(int i = 0; i < copCount; ++i) {
+        cops.add((int)(rng() % 100));
+    }
+    return cops;
+}
+static pair<Bitset<2>, Bitset<2>> randomPreSolveKey(mt19937_64& rng) {
+    Bitset<2> cops = randomCops(rng);
+    Bitset<2> robbers = Bitset<2>::empty();
+    for(int v = 0; v < 100; ++v) {
+        if(!cops.contains(v) && rng() % 2) {
+            robbers.add(v);
+        }
+    }
+    return {cops, robbers};
+}
+static pair<Bitset<2>, int> randomComponentKey(mt19937_64& rng) {
+    return {randomCops(rng), (int)(rng() % 100)};
+}
+
+static void printResult(
+    const char* name,
+    double insertTime,
+    double findTime,
+    size_t memoryUsage,
+    int count,
+    size_t size
+) {
+    cout << "    " << name << ":\n";
+    cout << "      Insertion: " << 1e9 * insertTime / count << " ns/key\n";
+    cout << "      Lookup: " << 1e9 * findTime / (2 * count) << " ns/key\n";
+    cout << "      Memory usage: " << (double)memoryUsage / size << " bytes/key\n";
+    cout << "      Distinct keys: " << size << '\n';
+}
+
+// Inserts count random keys to the maps and looks up each of them and
+// another count random keys, which are mostly missing
+template <typename K, typename V, typename F>
+static void benchmarkMaps(const char* name, int count, V value, F randomKey) {
+    mt19937_64 rng(1);
+    vector<K> keys;
+    vector<K> otherKeys;
+    for(int i = 0; i < count; ++i) {
+        keys.push_back(randomKey(rng));
+    }
+    for(int i = 0; i < count; ++i) {
+        otherKeys.push_back(randomKey(rng));
+    }
+
+    cout << "  " << name << ":\n";
+
+    {
+        size_t bytes = 0;
+        typedef CountingAllocator<pair<const K, V>> Alloc;
+        unordered_map<K, V, hash<K>, equal_to<K>, Alloc> map(0, hash<K>(), equal_to<K>(), Alloc(bytes));
+
+        Clock insertClock;
+        for(const K& key : keys) {
+            map.emplace(key, value);
+        }
+        double insertTime = insertClock.elapsedTime();
+
+        Clock findClock;
+        int found = 0;
+        for(int i = 0; i < count; ++i) {
+            found += (int)map.count(keys[i]);
+            found += (int)map.count(otherKeys[i]);
+        }
+        double findTime = findClock.elapsedTime();
+        CHECK(found >= (int)map.size());
+
+        printResult("unordered_map", insertTime, findTime, bytes + sizeof(map), count, map.size());
+    }
+
+    {
+        FlatHashMap<K, V> map;
+
+        Clock insertClock;
+        for(const K& key : keys) {
+            map.insert(key, value, hashKey(key));
+        }
+        double insertTime = insertClock.elapsedTime();
+
+        Clock findClock;
+        int found = 0;
+        for(int i = 0; i < count; ++i) {
+            found += (int)(map.find(keys[i], hashKey(keys[i])) != nullptr);
+            found += (int)(map.find(otherKeys[i], hashKey(otherKeys[i])) != nullptr);
+        }
+        double findTime = findClock.elapsedTime();
+        CHECK(found >= (int)map.size());
+
+        printResult("FlatHashMap", insertTime, findTime, map.memoryUsage() + sizeof(map), count, map.size());
+    }
+}
+
+// Runs the solver on the network with the exact oracle and prints the size of
+// its memo tables
+template <int W>
+static void benchmarkSolver(string filename, double timeLimit) {
+    Digraph<W> dag, cpdag;
+    tie(dag, cpdag) = readBnRepositoryNet<W>(filename);
+
+    cout << filename << ":\n";
+    BayesianOracle<W> oracle(dag, timeLimit);
+    BayesianNetworkTreeDecompositionSolver<W> solver(oracle, Bitset<W>::range(dag.vertCount()));
+    int tw = 1;
+    try {
+        while(!solver.solve(tw)) {
+            ++tw;
+        }
+        cout << "  Treewidth: " << tw << '\n';
+    } catch(typename BayesianOracle<W>::TimeLimitExceeded) {
+        cout << "  TIMEOUT at treewidth bound " << tw << '\n';
+    }
+    cout << "  Run time: " << oracle.elapsedTime() << " s\n";
+    cout << "  Memoized results: " << solver.memoSize() << '\n';
+    cout << "  Memo memory usage: " << solver.memoMemoryUsage() / 1024 << " KiB\n";
+}
+
+int main(int argc, char* argv[]) {
+    if(argc < 2) {
+        cerr << "Usage: ./memo_benchmark <key count> [time limit] [filename]...\n";
+        CHECK(false);
+    }
+
+    int count = parseString<int>(argv[1]);
+    CHECK(count > 0);
+    cout << count << " keys:\n";
+    benchmarkMaps<pair<Bitset<2>, Bitset<2>>>("(cops, robbers) -> (int, int)", count, make_pair(0, 0), randomPreSolveKey);
+    benchmarkMaps<pair<Bitset<2>, int>>("(cops, robber) -> component", count, Bitset<2>::empty(), randomComponentKey);
+
+    if(argc >= 3) {
+        double timeLimit = parseString<double>(argv[2]);
+        CHECK(isfinite(timeLimit) && timeLimit > 0.0);
+        for(int i = 3; i < argc; ++i) {
+            int vertCount = readBnRepositoryNetVertCount(argv[i]);
+            dispatchBitsetWordCount(vertCount, [&](auto words) {
+                benchmarkSolver<decltype(words)::value>(argv[i], timeLimit);
+            });
+        }
+    }
+
+    return 0;
+}
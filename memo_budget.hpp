@@ -0,0 +1,174 @@
+#pragma once
+
+#include "common.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+// Memory budget shared by memo tables that may evict their entries, such as
+// the tables of BayesianNetworkTreeDecompositionSolver. The tables register
+// their storage with the budget, and instead of growing past memoryCap in
+// total, they evict entries. The cap is approximate: a table being rebuilt
+// holds both its old and new storage for a moment, and concurrent tables may
+// grow at the same time. If spillDirectory is nonempty, the storage of the
+// tables, if at least SpillMinSize bytes, is mapped from unlinked files
+// created in it instead of anonymous memory, so that the kernel can write it
+// out under memory pressure. All the methods can be called from multiple
+// threads concurrently.
+class MemoBudget {
+public:
+    static constexpr size_t SpillMinSize = (size_t)1 << 16;
+
+    MemoBudget(size_t memoryCap, string spillDirectory = "")
+        : memoryCap_(memoryCap),
+          spillDirectory_(move(spillDirectory)),
+          memoryUsage_(0),
+          peakMemoryUsage_(0),
+          evictionCount_(0)
+    {}
+
+    MemoBudget(const MemoBudget&) = delete;
+    MemoBudget(MemoBudget&&) = delete;
+    MemoBudget& operator=(const MemoBudget&) = delete;
+    MemoBudget& operator=(MemoBudget&&) = delete;
+
+    size_t memoryCap() const {
+        return memoryCap_;
+    }
+    const string& spillDirectory() const {
+        return spillDirectory_;
+    }
+
+    // The memory usage of the storage of the tables in bytes, currently and
+    // at most so far
+    size_t memoryUsage() const {
+        return memoryUsage_.load(memory_order_relaxed);
+    }
+    size_t peakMemoryUsage() const {
+        return peakMemoryUsage_.load(memory_order_relaxed);
+    }
+
+    // The number of entries evicted from the tables
+    uint64_t evictionCount() const {
+        return evictionCount_.load(memory_order_relaxed);
+    }
+
+    // Returns true if size more bytes of storage fit in the cap
+    bool fits(size_t size) const {
+        return memoryUsage() + size <= memoryCap_;
+    }
+
+    void allocated(size_t size) {
+        size_t usage = memoryUsage_.fetch_add(size, memory_order_relaxed) + size;
+        size_t peak = peakMemoryUsage_.load(memory_order_relaxed);
+        while(usage > peak && !peakMemoryUsage_.compare_exchange_weak(peak, usage, memory_order_relaxed)) {}
+    }
+    void freed(size_t size) {
+        memoryUsage_.fetch_sub(size, memory_order_relaxed);
+    }
+    void evicted(uint64_t count) {
+        evictionCount_.fetch_add(count, memory_order_relaxed);
+    }
+
+private:
+    size_t memoryCap_;
+    string spillDirectory_;
+
+    atomic<size_t> memoryUsage_;
+    atomic<size_t> peakMemoryUsage_;
+    atomic<uint64_t> evictionCount_;
+};
+
+// Zero-initialized storage of a memo table, aligned to at least 16 bytes. The
+// storage is allocated from the heap, or mapped from a file in the spill
+// directory of the budget if it has one, and registered with the budget if
+// one is given.
+class MemoStorage {
+public:
+    MemoStorage()
+        : data_(nullptr),
+          size_(0),
+          budget_(nullptr),
+          mapped_(false)
+    {}
+
+    MemoStorage(size_t size, MemoBudget* budget)
+        : size_(size),
+          budget_(budget),
+          mapped_(
+              budget != nullptr &&
+              !budget->spillDirectory().empty() &&
+              size >= MemoBudget::SpillMinSize
+          )
+    {
+        CHECK(size > 0);
+        if(mapped_) {
+            string path = budget->spillDirectory() + "/memo.XXXXXX";
+            int fd = mkstemp(&path[0]);
+            CHECK(fd >= 0);
+            CHECK(!unlink(path.c_str()));
+            CHECK(!ftruncate(fd, (off_t)size));
+            data_ = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_NORESERVE, fd, 0);
+            CHECK(data_ != MAP_FAILED);
+            close(fd);
+        } else {
+            data_ = calloc(size, 1);
+            CHECK(data_ != nullptr);
+        }
+        CHECK((uintptr_t)data_ % 16 == 0);
+        if(budget_) {
+            budget_->allocated(size_);
+        }
+    }
+
+    MemoStorage(const MemoStorage&) = delete;
+    MemoStorage& operator=(const MemoStorage&) = delete;
+
+    MemoStorage(MemoStorage&& other)
+        : MemoStorage()
+    {
+        swap(other);
+    }
+    MemoStorage& operator=(MemoStorage&& other) {
+        MemoStorage(move(other)).swap(*this);
+        return *this;
+    }
+
+    ~MemoStorage() {
+        if(!data_) {
+            return;
+        }
+        if(mapped_) {
+            munmap(data_, size_);
+        } else {
+            free(data_);
+        }
+        if(budget_) {
+            budget_->freed(size_);
+        }
+    }
+
+    void swap(MemoStorage& other) {
+        std::swap(data_, other.data_);
+        std::swap(size_, other.size_);
+        std::swap(budget_, other.budget_);
+        std::swap(mapped_, other.mapped_);
+    }
+
+    void* data() const {
+        return data_;
+    }
+    size_t size() const {
+        return size_;
+    }
+    explicit operator bool() const {
+        return data_ != nullptr;
+    }
+
+private:
+    void* data_;
+    size_t size_;
+    MemoBudget* budget_;
+    bool mapped_;
+};
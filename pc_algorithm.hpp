@@ -3,19 +3,21 @@
 #include "bayesian_oracle.hpp"
 #include "cpdag.hpp"
 #include "graph.hpp"
+#include "thread_pool.hpp"
 
-Digraph pcAlgorithm(BayesianOracle& oracle) {
+template <int W>
+Digraph<W> pcAlgorithm(BayesianOracle<W>& oracle) {
     int vertCount = oracle.vertCount();
-    Graph skeleton = Graph::complete(vertCount);
+    Graph<W> skeleton = Graph<W>::complete(vertCount);
 
-    vector<pair<pair<int, int>, Bitset>> edgeSeparators;
+    vector<pair<pair<int, int>, Bitset<W>>> edgeSeparators;
 
     int i = 0;
     while(true) {
         for(int x = 0; x < vertCount; ++x) {
             skeleton.adjacentVerts(x).iterate([&](int y) {
-                Bitset sup = skeleton.adjacentVerts(x).without(y);
-                if(!sup.iterateSubsetsOfSizeWhile(i, [&](Bitset S) {
+                Bitset<W> sup = skeleton.adjacentVerts(x).without(y);
+                if(!sup.iterateSubsetsOfSizeWhile(i, [&](Bitset<W> S) {
                     if(oracle.indTest(x, S, y)) {
                         edgeSeparators.emplace_back(make_pair(x, y), S);
                         return false;
@@ -41,3 +43,78 @@ Digraph pcAlgorithm(BayesianOracle& oracle) {
 
     return constructCPDAG(skeleton, edgeSeparators);
 }
+
+// The PC-stable variant of the PC algorithm, parallelized using the given
+// thread pool. In each level, the adjacency sets are fixed at the start of the
+// level and the edges are removed only after all the tests of the level have
+// been run. Therefore the tests of each level are independent and can be run
+// in parallel, and the result does not depend on the number of threads.
+//
+// For each x, the separator candidates S are enumerated over the subsets of
+// the neighbors of x in the same order as in pcAlgorithm, and each S is tested
+// for all the remaining neighbors y at once, so that the oracle can run the
+// tests sharing x and S in one batch. The first separator found for each edge
+// is the same as when enumerating the subsets for each y separately.
+template <int W>
+Digraph<W> pcStableAlgorithm(BayesianOracle<W>& oracle, ThreadPool& pool) {
+    int vertCount = oracle.vertCount();
+    Graph<W> skeleton = Graph<W>::complete(vertCount);
+
+    vector<pair<pair<int, int>, Bitset<W>>> edgeSeparators;
+
+    int i = 0;
+    while(true) {
+        vector<Bitset<W>> adjacentVerts(vertCount);
+        for(int x = 0; x < vertCount; ++x) {
+            adjacentVerts[x] = skeleton.adjacentVerts(x);
+        }
+
+        // separators[x][y] is the separator found for edge (x, y), if y is
+        // contained in separated[x]
+        vector<Bitset<W>> separated(vertCount, Bitset<W>::empty());
+        vector<vector<Bitset<W>>> separators(vertCount);
+
+        TaskGroup group(pool);
+        for(int x = 0; x < vertCount; ++x) {
+            group.run([&, x]() {
+                separators[x].resize(vertCount);
+                Bitset<W> left = adjacentVerts[x];
+                adjacentVerts[x].iterateSubsetsOfSizeWhile(i, [&](Bitset<W> S) {
+                    Bitset<W> ys = left.minus(S);
+                    if(ys.isEmpty()) {
+                        return true;
+                    }
+                    Bitset<W> indYs = oracle.indTests(x, S, ys);
+                    indYs.iterate([&](int y) {
+                        separators[x][y] = S;
+                    });
+                    separated[x] = separated[x].unionWith(indYs);
+                    left = left.minus(indYs);
+                    return !left.isEmpty();
+                });
+            });
+        }
+        group.wait();
+
+        for(int x = 0; x < vertCount; ++x) {
+            separated[x].iterate([&](int y) {
+                if(skeleton.hasEdge(x, y)) {
+                    skeleton.delEdge(x, y);
+                    edgeSeparators.emplace_back(make_pair(x, y), separators[x][y]);
+                }
+            });
+        }
+
+        ++i;
+
+        int maxDeg = 0;
+        for(int v = 0; v < vertCount; ++v) {
+            maxDeg = max(maxDeg, skeleton.adjacentVerts(v).count());
+        }
+        if(maxDeg <= i) {
+            break;
+        }
+    }
+
+    return constructCPDAG(skeleton, edgeSeparators);
+}
@@ -1,114 +1,119 @@
 #pragma once
 
-#include "data.hpp"
+#include "chi_squared_critical.hpp"
+#include "contingency_counter.hpp"
+#include "independence_test.hpp"
 
-#include <boost/math/distributions/chi_squared.hpp>
+namespace pearson_chisq_ {
 
-// Returns true if a is independent of b given X according to Pearson's
-// chi-squared test applied to given data.
-bool pearsonChiSquaredIndTest(const Data& data, int a, Bitset X, int b) {
-    CHECK(a >= 0 && a <= (int)data.catCounts.size());
-    CHECK(b >= 0 && b <= (int)data.catCounts.size());
-    CHECK(a != b);
-    CHECK(X.isSubsetOf(Bitset::range((int)data.catCounts.size())));
-    CHECK(!X.contains(a));
-    CHECK(!X.contains(b));
-
-    vector<int> ord(data.points.size());
-    for(int i = 0; i < (int)ord.size(); ++i) {
-        ord[i] = i;
-    }
+// Pearson's chi-squared statistic of the contingency tables of a and b in the
+// strata of X
+inline double chiSquaredStatistic(const ContingencyTables& tables) {
+    int aCatCount = tables.aCatCount;
+    int bCatCount = tables.bCatCount;
 
-    vector<int> splits;
-    splits.push_back(0);
-    if(!ord.empty()) {
-        splits.push_back((int)ord.size());
-    }
+    double chisq = 0.0;
+    iterateStrata(tables, [&](
+        const uint32_t* counts,
+        const uint32_t* aCounts,
+        const uint32_t* bCounts,
+        uint32_t total
+    ) {
+        double N = (double)total;
+        for(int bVal = 0; bVal < bCatCount; ++bVal) {
+            for(int aVal = 0; aVal < aCatCount; ++aVal) {
+                double expected = (double)aCounts[aVal] * (double)bCounts[bVal] / N;
+                if(expected > 0.0) {
+                    double diff = (double)counts[bVal * aCatCount + aVal] - expected;
+                    chisq += diff * diff / expected;
+                }
+            }
+        }
+    });
+    return chisq;
+}
 
-    vector<int> newSplits;
+// Computes Pearson's chi-squared test at significance level alpha for a and b
+// from their contingency tables in the strata of X; configCount is the number
+// of configurations of X.
+inline bool testContingencyTables(
+    const ContingencyTables& tables,
+    double configCount,
+    double alpha
+) {
+    double freedom = contingencyFreedom(tables, configCount);
+    return chiSquaredStatistic(tables) < chiSquaredCriticalValue(freedom, alpha);
+}
 
-    double freedom = 1.0;
-    vector<vector<int>> bins;
+}
 
+// Runs pearsonChiSquaredIndTest for each pair (a, b) in pairs with the same
+// conditioning set X, counting the contingency tables with counter. Returns a
+// vector where element i is the result for pairs[i].
+template <int W>
+vector<bool> pearsonChiSquaredIndTests(
+    ContingencyCounter<W>& counter,
+    Bitset<W> X,
+    const vector<pair<int, int>>& pairs,
+    double alpha = 0.05
+) {
+    using namespace pearson_chisq_;
+
+    double configCount = 1.0;
     X.iterate([&](int v) {
-        freedom *= data.catCounts[v];
-
-        if((int)bins.size() < data.catCounts[v]) {
-            bins.resize(data.catCounts[v]);
-        }
-
-        newSplits.clear();
-        newSplits.push_back(0);
-        for(int s = 0; s < (int)splits.size() - 1; ++s) {
-            int x = splits[s];
-            int y = splits[s + 1];
-
-            if(y - x == 1) {
-                newSplits.push_back(y);
-            } else {
-                for(int c = 0; c < data.catCounts[v]; ++c) {
-                    bins[c].clear();
-                }
-                for(int i = x; i < y; ++i) {
-                    bins[data.points[ord[i]][v]].push_back(ord[i]);
-                }
-                int i = x;
-                for(int c = 0; c < data.catCounts[v]; ++c) {
-                    for(int p : bins[c]) {
-                        ord[i++] = p;
-                    }
-                    if(i != newSplits.back()) {
-                        newSplits.push_back(i);
-                    }
-                }
-            }
-        }
-        swap(splits, newSplits);
+        configCount *= (double)counter.data().catCount(v);
     });
 
-    int aCatCount = data.catCounts[a];
-    int bCatCount = data.catCounts[b];
-    vector<double> freqs(aCatCount * bCatCount);
-    vector<double> aFreqs(aCatCount);
-    vector<double> bFreqs(bCatCount);
+    vector<bool> ret(pairs.size());
+    counter.count(X, pairs, [&](int i, const ContingencyTables& tables) {
+        ret[i] = testContingencyTables(tables, configCount, alpha);
+    });
+    return ret;
+}
 
-    freedom *= (double)aCatCount - 1.0;
-    freedom *= (double)bCatCount - 1.0;
+// Runs pearsonChiSquaredIndTest for each pair (a, b) in pairs with the same
+// conditioning set X. The strata of the data points by X are computed only
+// once for all the pairs. Returns a vector where element i is the result for
+// pairs[i].
+template <int W>
+vector<bool> pearsonChiSquaredIndTests(
+    const Data& data,
+    Bitset<W> X,
+    const vector<pair<int, int>>& pairs,
+    double alpha = 0.05
+) {
+    ContingencyCounter<W> counter(data);
+    return pearsonChiSquaredIndTests(counter, X, pairs, alpha);
+}
 
-    double chisq = 0.0;
-    for(int s = 0; s < (int)splits.size() - 1; ++s) {
-        fill(freqs.begin(), freqs.end(), 0.0);
-        fill(aFreqs.begin(), aFreqs.end(), 0.0);
-        fill(bFreqs.begin(), bFreqs.end(), 0.0);
+// Returns true if a is independent of b given X according to Pearson's
+// chi-squared test at significance level alpha applied to given data.
+template <int W>
+bool pearsonChiSquaredIndTest(const Data& data, int a, Bitset<W> X, int b, double alpha = 0.05) {
+    return pearsonChiSquaredIndTests(data, X, {{a, b}}, alpha)[0];
+}
 
-        int x = splits[s];
-        int y = splits[s + 1];
-        double N = (double)(y - x);
-        double unit = 1.0 / N;
+// Pearson's chi-squared test at significance level alpha on the data of a
+// contingency counter, which must outlive the test
+template <int W>
+class PearsonChiSquaredTest : public IndependenceTest<W> {
+public:
+    PearsonChiSquaredTest(ContingencyCounter<W>& counter, double alpha = 0.05)
+        : counter_(counter),
+          alpha_(alpha)
+    {
+        CHECK(alpha > 0.0 && alpha < 1.0);
+    }
 
-        for(int i = x; i < y; ++i) {
-            int aVal = data.points[ord[i]][a];
-            int bVal = data.points[ord[i]][b];
-            freqs[bVal * aCatCount + aVal] += unit;
-            aFreqs[aVal] += unit;
-            bFreqs[bVal] += unit;
-        }
+    int varCount() const override {
+        return counter_.data().varCount();
+    }
 
-        double term = 0.0;
-        for(int aVal = 0; aVal < aCatCount; ++aVal) {
-            for(int bVal = 0; bVal < bCatCount; ++bVal) {
-                double expected = aFreqs[aVal] * bFreqs[bVal];
-                if(expected > 0.0) {
-                    double diff = freqs[bVal * aCatCount + aVal] - expected;
-                    term += diff * diff / expected;
-                }
-            }
-        }
-        term *= N;
-        chisq += term;
+    vector<bool> indTests(Bitset<W> X, const vector<pair<int, int>>& pairs) override {
+        return pearsonChiSquaredIndTests(counter_, X, pairs, alpha_);
     }
 
-    boost::math::chi_squared_distribution<> dist(freedom);
-    double crit = boost::math::quantile(dist, 0.95);
-    return chisq < crit;
-}
+private:
+    ContingencyCounter<W>& counter_;
+    double alpha_;
+};
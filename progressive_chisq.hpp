@@ -0,0 +1,201 @@
+#pragma once
+
+#include "pearson_chisq.hpp"
+
+namespace progressive_chisq_ {
+
+// Subsamples smaller than this are not used
+const int MinSubsampleSize = 1000;
+
+// Each subsample is this many times larger than the previous one
+const int SubsampleGrowth = 4;
+
+// Predicts the decision of the chi-squared test on the full data from the
+// statistic on a subsample of given fraction of the data points. Under
+// dependence, the statistic is noncentral chi-squared distributed with
+// noncentrality proportional to the number of data points, and its variance
+// is 2 (freedom + 2 noncentrality). The noncentrality of the subsample is
+// bounded from both sides by z standard deviations using the normal
+// approximation, the bounds are scaled to the full data, and the statistic on
+// the full data is in turn bounded by z standard deviations around them.
+// Returns 1 if the full data test would reject independence even at the lower
+// bound, 0 if it would accept independence even at the upper bound, and -1
+// otherwise.
+inline int predictDecision(
+    double statistic,
+    double freedom,
+    double criticalValue,
+    double fraction,
+    double z
+) {
+    // With u = sqrt(2 (freedom + 2 lambda)), the statistic at mean -+ z sd
+    // is freedom + (u^2 - 2 freedom) / 4 -+ z u; solving for u gives the
+    // noncentrality bounds.
+    double disc = 4.0 * z * z - 2.0 * freedom + 4.0 * statistic;
+    auto noncentrality = [&](double u) {
+        return max(0.0, (u * u - 2.0 * freedom) / 4.0);
+    };
+    double lower = disc > 0.0 ? noncentrality(max(0.0, sqrt(disc) - 2.0 * z)) : 0.0;
+    double upper = noncentrality(2.0 * z + sqrt(max(disc, 0.0)));
+
+    auto fullStatistic = [&](double lambda, double sign) {
+        lambda /= fraction;
+        return freedom + lambda + sign * z * sqrt(2.0 * (freedom + 2.0 * lambda));
+    };
+    if(fullStatistic(lower, -1.0) >= criticalValue) {
+        return 1;
+    }
+    if(fullStatistic(upper, 1.0) < criticalValue) {
+        return 0;
+    }
+    return -1;
+}
+
+}
+
+// Progressive-precision version of Pearson's chi-squared test for large data
+// sets. Each pair is first tested on a random subsample of the data points,
+// and escalated to larger subsamples and finally to the full data only if
+// the decision of the full data test cannot be predicted with confidence (see
+// progressive_chisq_::predictDecision). The subsamples are nested prefixes of
+// a random permutation of the data points with sizes growing from
+// fraction * pointCount by the factor SubsampleGrowth, determined by seed.
+template <int W>
+class ProgressiveChiSquaredTest : public IndependenceTest<W> {
+public:
+    // counter counts the tables of the full data; it must outlive the test.
+    // z is the number of standard deviations used in the bounds.
+    ProgressiveChiSquaredTest(
+        ContingencyCounter<W>& counter,
+        double alpha = 0.05,
+        double fraction = 0.1,
+        uint64_t seed = 0,
+        double z = 3.0
+    )
+        : counter_(counter),
+          alpha_(alpha),
+          z_(z)
+    {
+        using namespace progressive_chisq_;
+
+        CHECK(alpha > 0.0 && alpha < 1.0);
+        CHECK(fraction > 0.0 && fraction <= 1.0);
+        CHECK(z > 0.0);
+
+        const Data& data = counter.data();
+        int pointCount = data.pointCount();
+
+        // Fisher-Yates shuffle with an explicit mapping of the random
+        // numbers, so that the subsamples do not depend on the standard
+        // library
+        vector<int> perm(pointCount);
+        for(int i = 0; i < pointCount; ++i) {
+            perm[i] = i;
+        }
+        mt19937_64 rng(seed);
+        for(int i = pointCount - 1; i > 0; --i) {
+            swap(perm[i], perm[(int)(rng() % (uint64_t)(i + 1))]);
+        }
+
+        double size = max(fraction * (double)pointCount, (double)MinSubsampleSize);
+        for(; size < (double)pointCount; size *= (double)SubsampleGrowth) {
+            vector<int> points(perm.begin(), perm.begin() + (int)size);
+            sort(points.begin(), points.end());
+            subsamples_.push_back(selectDataPoints(data, points));
+        }
+        for(const Data& subsample : subsamples_) {
+            subsampleCounters_.emplace_back(new ContingencyCounter<W>(subsample));
+        }
+
+        decidedCounts_.reset(new atomic<uint64_t>[subsamples_.size() + 1]());
+    }
+
+    int varCount() const override {
+        return counter_.data().varCount();
+    }
+
+    vector<bool> indTests(Bitset<W> X, const vector<pair<int, int>>& pairs) override {
+        using namespace progressive_chisq_;
+        using namespace pearson_chisq_;
+
+        double configCount = 1.0;
+        X.iterate([&](int v) {
+            configCount *= (double)counter_.data().catCount(v);
+        });
+
+        vector<bool> ret(pairs.size());
+        vector<int> pending(pairs.size());
+        for(int i = 0; i < (int)pairs.size(); ++i) {
+            pending[i] = i;
+        }
+
+        for(int k = 0; k < (int)subsamples_.size() && !pending.empty(); ++k) {
+            double fraction = (double)subsamples_[k].pointCount() / (double)counter_.data().pointCount();
+            vector<pair<int, int>> stagePairs;
+            for(int i : pending) {
+                stagePairs.push_back(pairs[i]);
+            }
+
+            vector<int> escalated;
+            subsampleCounters_[k]->count(X, stagePairs, [&](int j, const ContingencyTables& tables) {
+                double freedom = contingencyFreedom(tables, configCount);
+                int decision = predictDecision(
+                    chiSquaredStatistic(tables),
+                    freedom,
+                    chiSquaredCriticalValue(freedom, alpha_),
+                    fraction,
+                    z_
+                );
+                if(decision == -1) {
+                    escalated.push_back(pending[j]);
+                } else {
+                    ret[pending[j]] = decision == 0;
+                }
+            });
+            decidedCounts_[k].fetch_add(pending.size() - escalated.size(), memory_order_relaxed);
+            pending = move(escalated);
+        }
+
+        if(!pending.empty()) {
+            vector<pair<int, int>> fullPairs;
+            for(int i : pending) {
+                fullPairs.push_back(pairs[i]);
+            }
+            vector<bool> results = pearsonChiSquaredIndTests(counter_, X, fullPairs, alpha_);
+            for(int j = 0; j < (int)pending.size(); ++j) {
+                ret[pending[j]] = results[j];
+            }
+            decidedCounts_[subsamples_.size()].fetch_add(pending.size(), memory_order_relaxed);
+        }
+        return ret;
+    }
+
+    // The sizes of the subsamples followed by the size of the full data
+    vector<int> stageSizes() const {
+        vector<int> ret;
+        for(const Data& subsample : subsamples_) {
+            ret.push_back(subsample.pointCount());
+        }
+        ret.push_back(counter_.data().pointCount());
+        return ret;
+    }
+
+    // The number of pair tests decided at each stage of stageSizes; all but
+    // the first were escalated from a smaller subsample
+    vector<uint64_t> decidedCounts() const {
+        vector<uint64_t> ret;
+        for(int k = 0; k <= (int)subsamples_.size(); ++k) {
+            ret.push_back(decidedCounts_[k].load(memory_order_relaxed));
+        }
+        return ret;
+    }
+
+private:
+    ContingencyCounter<W>& counter_;
+    double alpha_;
+    double z_;
+
+    vector<Data> subsamples_;
+    vector<unique_ptr<ContingencyCounter<W>>> subsampleCounters_;
+    unique_ptr<atomic<uint64_t>[]> decidedCounts_;
+};
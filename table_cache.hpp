@@ -0,0 +1,86 @@
+#pragma once
+
+#include "bitset.hpp"
+#include "contingency.hpp"
+#include "lru_cache.hpp"
+
+// Table of the joint counts of a set of variables. The count of the values
+// vals[0], ..., vals[k - 1] of vars[0], ..., vars[k - 1] is at the mixed-radix
+// index vals[0] + catCounts[vars[0]] * (vals[1] + catCounts[vars[1]] * ...).
+struct JointTable {
+    vector<int> vars;
+    vector<uint32_t> counts;
+};
+
+// Computes the contingency tables of a and b in the strata of X, numbered in
+// mixed-radix order of X, by marginalizing table, which must contain all of
+// them
+template <int W>
+void marginalizeJointTable(
+    const JointTable& table,
+    const vector<int>& catCounts,
+    Bitset<W> X,
+    int a,
+    int b,
+    ContingencyTables& tables
+) {
+    int aCatCount = catCounts[a];
+    int bCatCount = catCounts[b];
+    int configCount = 1;
+    X.iterate([&](int v) {
+        configCount *= catCounts[v];
+    });
+
+    tables.aCatCount = aCatCount;
+    tables.bCatCount = bCatCount;
+    tables.stratumCount = configCount;
+    tables.sparse = false;
+    tables.counts.assign((size_t)configCount * aCatCount * bCatCount, 0);
+
+    // The index in tables.counts advances by multipliers[k] when the value of
+    // table.vars[k] is incremented; zero for the marginalized variables
+    int varCount = (int)table.vars.size();
+    vector<size_t> multipliers(varCount, 0);
+    for(int k = 0; k < varCount; ++k) {
+        int v = table.vars[k];
+        if(v == a) {
+            multipliers[k] = 1;
+        } else if(v == b) {
+            multipliers[k] = aCatCount;
+        } else if(X.contains(v)) {
+            size_t radix = (size_t)aCatCount * bCatCount;
+            X.iterate([&](int x) {
+                if(x < v) {
+                    radix *= catCounts[x];
+                }
+            });
+            multipliers[k] = radix;
+        }
+    }
+
+    vector<int> vals(varCount, 0);
+    size_t idx = 0;
+    for(uint32_t count : table.counts) {
+        tables.counts[idx] += count;
+        for(int k = 0; k < varCount; ++k) {
+            idx += multipliers[k];
+            if(++vals[k] < catCounts[table.vars[k]]) {
+                break;
+            }
+            idx -= multipliers[k] * vals[k];
+            vals[k] = 0;
+        }
+    }
+}
+
+// Cache of joint count tables keyed by their variable sets
+template <int W>
+using JointTableCache = LruCache<Bitset<W>, JointTable>;
+
+// Estimate of the memory taken by table in bytes
+inline size_t jointTableSize(const JointTable& table) {
+    return
+        sizeof(JointTable) +
+        table.vars.size() * sizeof(int) +
+        table.counts.size() * sizeof(uint32_t);
+}
@@ -0,0 +1,255 @@
+#pragma once
+
+#include "common.hpp"
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <thread>
+
+class TaskGroup;
+
+// Work-stealing thread pool. Each worker thread has its own task deque: it
+// runs the tasks it spawns itself in LIFO order from the back of its deque and
+// steals from the front of the other deques when it runs out of work. Tasks
+// are spawned and waited on through TaskGroups; a thread waiting for a group
+// runs other tasks in the meantime, so tasks may spawn and wait for subtasks.
+class ThreadPool {
+public:
+    // Starts threadCount worker threads. With zero worker threads, all the
+    // tasks are run by the threads that wait for them.
+    ThreadPool(int threadCount)
+        : queues_(threadCount + 1),
+          queuedTaskCount_(0),
+          stopping_(false)
+    {
+        CHECK(threadCount >= 0);
+        for(int i = 0; i < threadCount; ++i) {
+            threads_.emplace_back([this, i]() {
+                workerMain_(i);
+            });
+        }
+    }
+
+    ~ThreadPool() {
+        {
+            lock_guard<mutex> lock(sleepMutex_);
+            stopping_ = true;
+        }
+        sleepCv_.notify_all();
+        for(thread& t : threads_) {
+            t.join();
+        }
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool(ThreadPool&&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+    ThreadPool& operator=(ThreadPool&&) = delete;
+
+    int threadCount() const {
+        return (int)threads_.size();
+    }
+
+private:
+    struct Task {
+        function<void()> func;
+        TaskGroup* group;
+    };
+
+    struct Queue {
+        mutex queueMutex;
+        deque<Task> tasks;
+    };
+
+    // queues_[i] for i < threadCount() belongs to worker thread i, and the
+    // last one is shared by the threads outside the pool
+    vector<Queue> queues_;
+    vector<thread> threads_;
+
+    mutex sleepMutex_;
+    condition_variable sleepCv_;
+    atomic<int> queuedTaskCount_;
+    bool stopping_;
+
+    static thread_local ThreadPool* currentPool_;
+    static thread_local int currentWorkerIdx_;
+
+    void workerMain_(int workerIdx) {
+        currentPool_ = this;
+        currentWorkerIdx_ = workerIdx;
+        while(true) {
+            if(tryRunTask_()) {
+                continue;
+            }
+            unique_lock<mutex> lock(sleepMutex_);
+            sleepCv_.wait(lock, [&]() {
+                return stopping_ || queuedTaskCount_.load() > 0;
+            });
+            if(stopping_) {
+                break;
+            }
+        }
+        currentPool_ = nullptr;
+    }
+
+    int ownQueueIdx_() const {
+        if(currentPool_ == this) {
+            return currentWorkerIdx_;
+        } else {
+            return (int)queues_.size() - 1;
+        }
+    }
+
+    void push_(Task task) {
+        Queue& queue = queues_[ownQueueIdx_()];
+        {
+            lock_guard<mutex> lock(queue.queueMutex);
+            queue.tasks.push_back(move(task));
+        }
+        queuedTaskCount_.fetch_add(1);
+        {
+            lock_guard<mutex> lock(sleepMutex_);
+        }
+        sleepCv_.notify_one();
+    }
+
+    // Takes a task from the back of the own queue, or steals one from the
+    // front of another queue. Returns false if there were no tasks.
+    bool tryPop_(Task& task) {
+        if(queuedTaskCount_.load() == 0) {
+            return false;
+        }
+        int ownIdx = ownQueueIdx_();
+        int queueCount = (int)queues_.size();
+        for(int i = 0; i < queueCount; ++i) {
+            Queue& queue = queues_[(ownIdx + i) % queueCount];
+            lock_guard<mutex> lock(queue.queueMutex);
+            if(!queue.tasks.empty()) {
+                if(i == 0) {
+                    task = move(queue.tasks.back());
+                    queue.tasks.pop_back();
+                } else {
+                    task = move(queue.tasks.front());
+                    queue.tasks.pop_front();
+                }
+                queuedTaskCount_.fetch_sub(1);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool tryRunTask_();
+
+    void notifyAll_() {
+        {
+            lock_guard<mutex> lock(sleepMutex_);
+        }
+        sleepCv_.notify_all();
+    }
+
+    friend class TaskGroup;
+};
+
+thread_local ThreadPool* ThreadPool::currentPool_ = nullptr;
+thread_local int ThreadPool::currentWorkerIdx_ = -1;
+
+// Group of tasks run in a ThreadPool. If a task throws an exception, the group
+// is cancelled and the exception is rethrown by wait().
+class TaskGroup {
+public:
+    TaskGroup(ThreadPool& pool)
+        : pool_(pool),
+          pendingCount_(0),
+          cancelled_(false)
+    {}
+
+    // Waits for the remaining tasks but ignores their exceptions
+    ~TaskGroup() {
+        cancel();
+        waitImpl_();
+    }
+
+    TaskGroup(const TaskGroup&) = delete;
+    TaskGroup(TaskGroup&&) = delete;
+    TaskGroup& operator=(const TaskGroup&) = delete;
+    TaskGroup& operator=(TaskGroup&&) = delete;
+
+    void run(function<void()> func) {
+        pendingCount_.fetch_add(1);
+        pool_.push_({move(func), this});
+    }
+
+    // Waits until all the tasks of the group have finished, running tasks of
+    // the pool in the meantime. Rethrows the first exception thrown by a task.
+    void wait() {
+        waitImpl_();
+        if(exception_) {
+            exception_ptr e = exception_;
+            exception_ = nullptr;
+            rethrow_exception(e);
+        }
+    }
+
+    // The tasks that have not started yet are skipped. The running tasks may
+    // poll cancelled() to stop early.
+    void cancel() {
+        cancelled_.store(true, memory_order_relaxed);
+    }
+    bool cancelled() const {
+        return cancelled_.load(memory_order_relaxed);
+    }
+
+private:
+    ThreadPool& pool_;
+    atomic<int> pendingCount_;
+    atomic<bool> cancelled_;
+    mutex exceptionMutex_;
+    exception_ptr exception_;
+
+    void waitImpl_() {
+        while(pendingCount_.load() != 0) {
+            if(pool_.tryRunTask_()) {
+                continue;
+            }
+            unique_lock<mutex> lock(pool_.sleepMutex_);
+            pool_.sleepCv_.wait(lock, [&]() {
+                return pendingCount_.load() == 0 || pool_.queuedTaskCount_.load() > 0;
+            });
+        }
+    }
+
+    void runTask_(function<void()>& func) {
+        if(!cancelled()) {
+            try {
+                func();
+            } catch(...) {
+                {
+                    lock_guard<mutex> lock(exceptionMutex_);
+                    if(!exception_) {
+                        exception_ = current_exception();
+                    }
+                }
+                cancel();
+            }
+        }
+
+        // The group may be destroyed as soon as the count reaches zero
+        ThreadPool& pool = pool_;
+        if(pendingCount_.fetch_sub(1) == 1) {
+            pool.notifyAll_();
+        }
+    }
+
+    friend class ThreadPool;
+};
+
+inline bool ThreadPool::tryRunTask_() {
+    Task task;
+    if(!tryPop_(task)) {
+        return false;
+    }
+    task.group->runTask_(task.func);
+    return true;
+}
@@ -2,22 +2,34 @@
 
 #include "graph.hpp"
 
+template <int W>
 struct TreeDecompositionNode {
-    Bitset verts;
+    Bitset<W> verts;
 
     // Missing child is marked with -1
     int child1;
     int child2;
 };
-typedef std::vector<TreeDecompositionNode> TreeDecomposition;
+template <int W>
+bool operator==(const TreeDecompositionNode<W>& a, const TreeDecompositionNode<W>& b) {
+    return a.verts == b.verts && a.child1 == b.child1 && a.child2 == b.child2;
+}
+template <int W>
+bool operator!=(const TreeDecompositionNode<W>& a, const TreeDecompositionNode<W>& b) {
+    return !(a == b);
+}
+
+template <int W>
+using TreeDecomposition = std::vector<TreeDecompositionNode<W>>;
 
 namespace tree_decomposition_check_ {
 
-Bitset subtreeVertsUnion(const TreeDecomposition& treeDecomposition, int nodeIdx) {
+template <int W>
+Bitset<W> subtreeVertsUnion(const TreeDecomposition<W>& treeDecomposition, int nodeIdx) {
     CHECK(nodeIdx >= 0 && nodeIdx < (int)treeDecomposition.size());
-    const TreeDecompositionNode& node = treeDecomposition[nodeIdx];
+    const TreeDecompositionNode<W>& node = treeDecomposition[nodeIdx];
     CHECK(!node.verts.isEmpty());
-    Bitset ret = node.verts;
+    Bitset<W> ret = node.verts;
     if(node.child1 != -1) {
         CHECK(node.child1 > nodeIdx);
         ret = ret.unionWith(subtreeVertsUnion(treeDecomposition, node.child1));
@@ -29,15 +41,16 @@ Bitset subtreeVertsUnion(const TreeDecomposition& treeDecomposition, int nodeIdx
     return ret;
 }
 
+template <int W>
 void checkRunningIntersection(
-    const TreeDecomposition& treeDecomposition,
-    Bitset& vertsSeen,
-    Bitset parentVerts,
+    const TreeDecomposition<W>& treeDecomposition,
+    Bitset<W>& vertsSeen,
+    Bitset<W> parentVerts,
     int nodeIdx
 ) {
     CHECK(nodeIdx >= 0 && nodeIdx < (int)treeDecomposition.size());
-    const TreeDecompositionNode& node = treeDecomposition[nodeIdx];
-    Bitset verts = node.verts;
+    const TreeDecompositionNode<W>& node = treeDecomposition[nodeIdx];
+    Bitset<W> verts = node.verts;
     CHECK(verts.intersectWith(vertsSeen.minus(parentVerts)).isEmpty());
     vertsSeen = vertsSeen.unionWith(verts);
 
@@ -51,28 +64,29 @@ void checkRunningIntersection(
 
 }
 
+template <int W>
 void checkTreeDecompositions(
-    const vector<TreeDecomposition>& treeDecompositions,
-    const Graph& graph,
+    const vector<TreeDecomposition<W>>& treeDecompositions,
+    const Graph<W>& graph,
     int tw
 ) {
     using namespace tree_decomposition_check_;
 
-    Bitset vertsSeen = Bitset::empty();
-    for(const TreeDecomposition& treeDecomposition : treeDecompositions) {
-        Bitset verts = subtreeVertsUnion(treeDecomposition, 0);
+    Bitset<W> vertsSeen = Bitset<W>::empty();
+    for(const TreeDecomposition<W>& treeDecomposition : treeDecompositions) {
+        Bitset<W> verts = subtreeVertsUnion(treeDecomposition, 0);
         CHECK(verts.intersectWith(vertsSeen).isEmpty());
         vertsSeen = vertsSeen.unionWith(verts);
     }
-    CHECK(vertsSeen == Bitset::range(graph.vertCount()));
+    CHECK(vertsSeen == Bitset<W>::range(graph.vertCount()));
 
-    vector<Bitset> adjacentVertsSupset(graph.vertCount(), Bitset::empty());
-    for(const TreeDecomposition& treeDecomposition : treeDecompositions) {
+    vector<Bitset<W>> adjacentVertsSupset(graph.vertCount(), Bitset<W>::empty());
+    for(const TreeDecomposition<W>& treeDecomposition : treeDecompositions) {
         vector<bool> hasParent(treeDecomposition.size(), false);
         hasParent[0] = true;
         for(int nodeIdx = 0; nodeIdx < (int)treeDecomposition.size(); ++nodeIdx) {
             CHECK(hasParent[nodeIdx]);
-            Bitset verts = treeDecomposition[nodeIdx].verts;
+            Bitset<W> verts = treeDecomposition[nodeIdx].verts;
             CHECK(verts.count() <= tw + 1);
             verts.iterate([&](int v) {
                 adjacentVertsSupset[v] = adjacentVertsSupset[v].unionWith(verts.without(v));
@@ -90,9 +104,9 @@ void checkTreeDecompositions(
         CHECK(graph.adjacentVerts(v).isSubsetOf(adjacentVertsSupset[v]));
     }
 
-    for(const TreeDecomposition& treeDecomposition : treeDecompositions) {
-        Bitset vertsSeen = Bitset::empty();
-        Bitset parentVerts = Bitset::empty();
+    for(const TreeDecomposition<W>& treeDecomposition : treeDecompositions) {
+        Bitset<W> vertsSeen = Bitset<W>::empty();
+        Bitset<W> parentVerts = Bitset<W>::empty();
         checkRunningIntersection(treeDecomposition, vertsSeen, parentVerts, 0);
     }
 }
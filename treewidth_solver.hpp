@@ -63,19 +63,20 @@ public:
     TreewidthSolver& operator=(const TreewidthSolver&) = delete;
     TreewidthSolver& operator=(TreewidthSolver&&) = delete;
 
-    int solve(const Graph& graph) {
+    template <int W>
+    int solve(const Graph<W>& graph) {
         if(graph.vertCount() == 0) {
             return 0;
         }
 
         int edgeCount = 0;
         for(int v = 0; v < graph.vertCount(); ++v) {
-            edgeCount += graph.adjacentVerts(v).minus(Bitset::range(v)).count();
+            edgeCount += graph.adjacentVerts(v).minus(Bitset<W>::range(v)).count();
         }
 
         CHECK(fprintf(input_, "p tw %d %d\n", graph.vertCount(), edgeCount) >= 0);
         for(int v = 0; v < graph.vertCount(); ++v) {
-            graph.adjacentVerts(v).minus(Bitset::range(v)).iterate([&](int x) {
+            graph.adjacentVerts(v).minus(Bitset<W>::range(v)).iterate([&](int x) {
                 CHECK(fprintf(input_, "%d %d\n", v + 1, x + 1) >= 0);
             });
         }